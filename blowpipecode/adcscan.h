@@ -0,0 +1,134 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Continuous acquisition of ADC0, ADC1 and ADC2 in the background
+ * The ADC runs free, DMA fills the ring of frames of the driver and the
+ * control core takes what is complete without waiting:
+ *   ESP32_S3: continuous mode, ADC_SCAN_HZ conversions per second in total,
+ *     ADC_SCAN_AVG per channel and frame averaged by the core, the driver
+ *     keeps two frames, a slow (idle) tick gets the newest ones
+ *   RP2040W: ADCInput, round robin over the channels in its DMA buffers
+ * cAdcScan:
+ *   begin(): setup(), starts the acquisition
+ *   poll(): control core, once per tick, publishes the mean of each channel
+ *     since the last poll with 4 bits more (0..65535)
+ *   get(pin)/getRaw(pin): latest value of ADC0/1/2, 16 or 12 bit, any core
+ *   getStatus(pBuffer): mode, frames and polls without one
+ * With ADC_SCAN 0 or a refused start poll() reads one channel per tick with
+ * ADC_READ_AVG analogRead() calls, round robin.
+ */
+#ifndef ADCSCAN_H
+#define ADCSCAN_H
+
+#include <atomic>
+#if ADC_SCAN && RP2040W
+#include <ADCInput.h>
+#endif
+
+#define ADC_CHANNELS 3
+
+class cAdcScan {
+    const uint8_t aPin[ADC_CHANNELS] = { ADC0, ADC1, ADC2 };
+    std::atomic<uint16_t> aValue[ADC_CHANNELS]; // 12 bit << 4
+    uint32_t aSum[ADC_CHANNELS];
+    uint32_t aCount[ADC_CHANNELS];
+    uint32_t frames;
+    uint32_t empty;     // polls without a frame
+    bool running;
+    int next;           // channel of the next sample or analogRead()
+#if ADC_SCAN && RP2040W
+    ADCInput input;
+#endif
+
+    int index(int pin) const {
+        for (int idx = 0; idx < ADC_CHANNELS; idx++) {
+            if (aPin[idx] == pin) {
+                return idx;
+            }
+        }
+        return 0;
+    }
+
+    void collect() {
+#if ADC_SCAN && ESP32_S3
+        adc_continuous_data_t *pResult = nullptr;
+        while (analogContinuousRead(&pResult, 0)) {
+            for (int idx = 0; idx < ADC_CHANNELS; idx++) {
+                int ch = index(pResult[idx].pin);
+                aSum[ch] += pResult[idx].avg_read_raw;
+                aCount[ch]++;
+            }
+            frames++;
+        }
+#elif ADC_SCAN && RP2040W
+        for (int cnt = input.available(); 0 < cnt; cnt--) {
+            aSum[next] += input.read();
+            aCount[next]++;
+            next = (next + 1) % ADC_CHANNELS;
+            frames += next == 0;
+        }
+#endif
+    }
+
+    public:
+    cAdcScan() : frames(0), empty(0), running(false), next(0)
+#if ADC_SCAN && RP2040W
+                 , input(ADC0, ADC1, ADC2)
+#endif
+    {
+        for (int idx = 0; idx < ADC_CHANNELS; idx++) {
+            aValue[idx] = 0;
+            aSum[idx] = aCount[idx] = 0;
+        }
+    }
+
+    void begin() {
+#if ADC_SCAN && ESP32_S3
+        running = analogContinuous(aPin, ADC_CHANNELS, ADC_SCAN_AVG, ADC_SCAN_HZ, nullptr) &&
+                  analogContinuousStart();
+#elif ADC_SCAN && RP2040W
+        running = input.begin(ADC_SCAN_HZ);
+#endif
+    }
+
+    void poll() {
+        if (!running) {
+            uint32_t sum = 0;
+            for (int cnt = 0; cnt < ADC_READ_AVG; cnt++) {
+                sum += analogRead(aPin[next]);
+            }
+            aValue[next] = (sum << 4) / ADC_READ_AVG;
+            next = (next + 1) % ADC_CHANNELS;
+            return;
+        }
+        uint32_t before = frames;
+        collect();
+        empty += before == frames;
+        for (int idx = 0; idx < ADC_CHANNELS; idx++) {
+            if (aCount[idx]) {
+                aValue[idx] = (aSum[idx] << 4) / aCount[idx];
+                aSum[idx] = aCount[idx] = 0;
+            }
+        }
+    }
+
+    uint16_t get(int pin) const { return aValue[index(pin)]; }
+    int getRaw(int pin) const { return aValue[index(pin)] >> 4; }
+
+    void getStatus(char *pBuffer) {
+        if (running) {
+            sprintf(pBuffer, "ADC: continuous %d/s, %lu frames, empty ticks %lu",
+                    ADC_SCAN_HZ, (unsigned long) frames, (unsigned long) empty);
+        } else {
+            sprintf(pBuffer, "ADC: %d analogRead() per tick, one channel per tick", ADC_READ_AVG);
+        }
+    }
+};
+
+extern cAdcScan adcScan;
+
+#endif // ADCSCAN_H
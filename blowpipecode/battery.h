@@ -0,0 +1,108 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Battery state of charge and runtime remaining
+ * cBattery:
+ *   add(mV, loadMa, now): one reading per control tick, now in us, the
+ *     reading plus the sag loadMa * BATT_RINT_MOHM is the voltage at rest,
+ *     filtered with BATT_TAU_MS, the load with BATT_LOAD_TAU_MS
+ *   loadMa(idle, duty): load model, board and radio by the power mode plus
+ *     the pump (duty > 0) or the vent (duty < 0), duty -255..255
+ *   getSoc(): percent from the discharge curve, -1 without a pack (USB)
+ *   getMinutes(): remaining charge at the mean load, -1 without a pack
+ *   getMv(): filtered voltage at rest
+ *   getStatus(pBuffer, pTitle): pack, voltage, charge, runtime and load
+ * The pack is chosen at the first reading above BATT_MIN_MV, above
+ * BATT_3S_MV a 3S (11.1 V) pack, else a 2S (7.4 V) one, with the capacity
+ * BATT_MAH_3S/BATT_MAH_2S. Both use the LiPo curve of a cell at rest.
+ * Written by the control core only, the web pages read without a lock.
+ */
+#ifndef BATTERY_H
+#define BATTERY_H
+
+// cell mV at rest for 0, 10, .. 100 %
+static const uint16_t aBattCellMv[11] = {
+    3270, 3690, 3730, 3770, 3800, 3840, 3870, 3950, 4020, 4110, 4200
+};
+
+class cBattery {
+    int cells;             // 0: no pack
+    int64_t restMv;        // mV << 16
+    int64_t meanMa;        // mA << 16
+    unsigned long last;    // us
+    int soc;
+    int minutes;
+
+    // first order low pass with the time constant tauMs over dt us
+    static void lowPass(int64_t &val, int32_t in, unsigned long dt, uint32_t tauMs) {
+        uint64_t tau = 1000ULL * tauMs;
+        dt = dt < tau ? dt : tau;
+        val += ((((int64_t) in) << 16) - val) * (int64_t) dt / (int64_t) (tau + dt);
+    }
+
+    static int socOf(int cellMv) {
+        if (cellMv <= aBattCellMv[0]) {
+            return 0;
+        }
+        for (int idx = 1; idx < 11; idx++) {
+            if (cellMv < aBattCellMv[idx]) {
+                int lo = aBattCellMv[idx - 1];
+                return (idx - 1) * 10 + 10 * (cellMv - lo) / (aBattCellMv[idx] - lo);
+            }
+        }
+        return 100;
+    }
+
+    public:
+    cBattery() : cells(0), restMv(0), meanMa(0), last(0), soc(-1), minutes(-1) {}
+
+    static int loadMa(bool idle, int duty) {
+        int ma = idle ? BATT_IDLE_MA : BATT_ACTIVE_MA;
+        return ma + (0 < duty ? BATT_MOTOR_MA * duty : BATT_VENT_MA * -duty) / 255;
+    }
+
+    void add(int mV, int load, unsigned long now) {
+        int32_t rest = mV + load * BATT_RINT_MOHM / 1000;
+        unsigned long dt = now - last;
+
+        last = now;
+        if (mV < BATT_MIN_MV) {
+            cells = 0; // pack removed, the next one may be another type
+            soc = minutes = -1;
+            return;
+        }
+        if (!cells) {
+            cells = BATT_3S_MV < rest ? 3 : 2;
+            restMv = (int64_t) rest << 16;
+            meanMa = (int64_t) load << 16;
+        } else {
+            lowPass(restMv, rest, dt, BATT_TAU_MS);
+            lowPass(meanMa, load, dt, BATT_LOAD_TAU_MS);
+        }
+        soc = socOf((int) (restMv >> 16) / cells);
+        int ma = (int) (meanMa >> 16);
+        minutes = (int) ((int64_t) soc * (cells == 3 ? BATT_MAH_3S : BATT_MAH_2S) * 60 / 100 / (ma ? ma : 1));
+    }
+
+    int getSoc() const { return soc; }
+    int getMinutes() const { return minutes; }
+    int getMv() const { return cells ? (int) (restMv >> 16) : 0; }
+
+    void getStatus(char *pBuffer, const char *pTitle) {
+        if (!cells) {
+            sprintf(pBuffer, "%s: no pack", pTitle);
+            return;
+        }
+        int mv = getMv();
+        sprintf(pBuffer, "%s: %dS %d.%02d V at rest, %d%%, %d min left at %d mA",
+                pTitle, cells, mv / 1000, mv % 1000 / 10, soc, minutes, (int) (meanMa >> 16));
+    }
+};
+
+extern cBattery battery;
+
+#endif // BATTERY_H
@@ -11,10 +11,10 @@
  * Supprted HW:
  * Display: SH1106G over I2C @ I2C0, address 0x3C
  * M24C02: EEProm(2Kbit/256 bytes) address 0x50 on I2C1
- * MS5607: pressure and temp sensor on I2C1 Address 0x76 or 0x77 (checks)
+ * MS5607: pressure and temp sensor on I2C1 Address 0x76 or 0x77 (checks), read without blocking
  * DRV8837: two motor controller to handle the motor and vent using 6 GPIO
  * ADC1: Monitor the battery voltage (1/11 * BatVolt)
- * Supports 7.5 or 11.1V battery
+ * Supports 7.4 or 11.1V battery, state of charge and runtime in battery.h
  *
  * 4 Operation modes (based on EEPROM content):
  * * PB_UNSET_NOPROM: unable to access the EEPROM - HW issue should not happen
@@ -32,25 +32,62 @@
 #define ESP32_S3 1
 
 #include <LittleFS.h>
+#include "corelink.h"
+
+// Wire1 is shared by the sensor (control core) and the EEPROM (web handlers)
+cBusGuard wire1Guard;
+#define M24C02_LOCK()   wire1Guard.lock()
+#define M24C02_UNLOCK() wire1Guard.unlock()
+
 #include "m24c02.h"
+#include "cfgstore.h"
+#include "ms5607.h"
+#include "ctrltick.h"
 #include "setting.h"
+#include "profiler.h"
+#include "ota.h"
+#include "telemetry.h"
+#include "flightrec.h"
+#include "wifilink.h"
+#include "power.h"
+#include "adcscan.h"
+#include "battery.h"
 #include "server_unset.h"
+#include "pressfilter.h"
 #include "client_blow.h"
+#include "pressurectrl.h"
+#include "params.h"
+#include "touch.h"
 #include "server_pipe.h"
 
-struct sUDPData UDPdata;
+cLatest<sLocalState> localLink;
 DRV8837 motor(MOTO_S, MOTO_1, MOTO_2);
 DRV8837 vent(VENT_S, VENT_1, VENT_2);
-MS5xxx sensor(&PRESSURE_I2C);
+cMS5607 sensor(PRESSURE_I2C);
 
 char aIPaddress[17] = "xxx.xxx.xxx.xxx";
 
-cMenueInfo mainMenu(aTouchSensor, aMainMenu);
 cDisplay display(DISP_I2C);
 
+cTick ctrlTick(CTRL_RATE_HZ);
+cTick dispTick(DISP_RATE_HZ);
+
 AsyncWebServer server(80);
+cTelemetry telemetry("/events", TELEM_RATE_HZ);
+cFlightRec flightRec;
+cWifiLink wifiLink;
+cPowerMode power;
+cAdcScan adcScan;
+cBattery battery;
+cTouchInput touchInput;
+cTouchMenu touchMenu(aMainMenu);
+cParamTable pipeParams;
+#if PROFILE
+cProfiler profiler;
+#endif
 WiFiUDP Udp;
 cM24C02 eeprom(Wire1);
+cCfgStore cfg(eeprom);
 
 #ifndef WL_NO_MODULE
 #define WL_NO_MODULE WL_NO_SHIELD
@@ -98,6 +135,90 @@ int state = 0;
 int displayIdx;
 IPAddress serverAddr;
 
+// control core: read local data, receive/send and actuate
+void
+controlStep(unsigned long now)
+{
+  sLocalState local;
+
+  PROF_TICK(CTRL_CORE);
+  PROF_SCOPE(PROF_CTRL_TICK);
+  PROF_START(PROF_SENSOR);
+  if (CHECK(WITH_PRESSURE) && wire1Guard.tryLock()) {
+    sensor.poll(now); // EEPROM busy: keep the last value for this tick
+    wire1Guard.unlock();
+  }
+  PROF_STOP(PROF_SENSOR);
+  local.presPa = sensor.getPres();
+  local.pressure = local.presPa / 100;
+  local.temp = sensor.getTemp() / 10;
+  PROF_START(PROF_ADC);
+  adcScan.poll();
+  PROF_STOP(PROF_ADC);
+  int adc = adcScan.getRaw(BATT_VOLT);
+  local.mV = ADC2MV(adcScan.get(BATT_VOLT) >> 2) >> 2; // 14 bit keeps ADC2MV in 32 bit
+  // the load of the reading is the duty of the last tick
+  battery.add(local.mV, cBattery::loadMa(power.isIdle(), CHECK(STATE_PIPE) ? pipeDuty : 0), now);
+  local.soc = battery.getSoc();
+  local.minutes = battery.getMinutes();
+
+  switch (settingsFlags & (STATE_PIPE|STATE_BLOW|STATE_UNSET)) {
+  case STATE_PIPE: handlePipe(local); break;
+  case STATE_BLOW: handleBlow(local, adc); break;
+  default:
+  case STATE_UNSET: break;
+  }
+  localLink.put(local);
+}
+
+// display core: display, touch and housekeeping, web and Wi-Fi run here as well
+void
+displayStep()
+{
+  static sLocalState local;
+
+  PROF_TICK(DISP_CORE);
+  PROF_SCOPE(PROF_DISP_TICK);
+  power.apply(CHECK(STATE_BLOW)); // the pipe is the AP, its radio stays awake
+  localLink.get(local);
+  PROF_START(PROF_TOUCH);
+  touchMenu.poll(touchInput, millis());
+  PROF_STOP(PROF_TOUCH);
+  switch (settingsFlags & (STATE_PIPE|STATE_BLOW|STATE_UNSET)) {
+  case STATE_PIPE: displayPipe(); break;
+  case STATE_BLOW: displayBlow(local); break;
+  default:
+  case STATE_UNSET: handleUnset(local); break;
+  }
+}
+
+std::atomic<bool> coresReady(false);
+
+#if ESP32_S3
+void
+displayTask(void *pArg)
+{
+  touchInput.begin(aTouchSensor); // the touch interrupt runs on this core
+  for (;;) {
+    if (dispTick.due(micros())) {
+      displayStep();
+    }
+    vTaskDelay(1);
+  }
+}
+#endif
+
+void
+startCores()
+{
+#if ESP32_S3
+  xTaskCreatePinnedToCore(displayTask, "display", 8192, nullptr, 1, nullptr, DISP_CORE);
+#else
+  touchInput.begin(aTouchSensor);
+#endif
+  coresReady = true;
+}
+
 void setup(void) {
 
   pinMode(LED_BUILTIN, OUTPUT);
@@ -121,6 +242,10 @@ void setup(void) {
   digitalWrite(VENT_2, 1);
 
   analogReadResolution(12);
+  adcScan.begin();
+#if PROFILE
+  profiler.begin();
+#endif
   
   initWire(&Wire, I2C0_SCL, I2C0_SDA, 100000);
   // Wire.i2c_set_pullup_en(true);
@@ -152,16 +277,18 @@ void setup(void) {
 
   if (CHECK(WITH_EEPROM)) {
     eeprom.readAll();
-    if (MAJOR != eeprom.getByte(EEPROM_MAJOR) || MINOR != eeprom.getByte(EEPROM_MINOR) || PATCH != eeprom.getShort(EEPROM_PATCH)) {
-      eeprom.setByte(EEPROM_MAJOR, MAJOR);
-      eeprom.setByte(EEPROM_MINOR, MINOR);
-      eeprom.setShort(EEPROM_PATCH, PATCH);
-    }
+    cfg.begin(); // validates the cached content, migrates the old fixed offsets
+    uint8_t aVersion[4] = { MAJOR, MINOR, (uint8_t) PATCH, (uint8_t) (PATCH >> 8) };
+    cfg.set(REC_VERSION, aVersion, sizeof(aVersion)); // only written when it changed
   }
+  pipeParams.begin(CHECK(WITH_EEPROM)); // compile time settings, then the saved ones
 
   if (CHECK(WITH_PRESSURE)) {
     sensor.setI2Caddr(sensorAddr);
-    sensor.ReadProm();
+    if (!sensor.readProm()) {
+      // PROM CRC mismatch, do not trust the values
+      CLEAR(WITH_PRESSURE);
+    }
   }
 
   if (CHECK(WITH_DISPLAY)) {
@@ -170,7 +297,6 @@ void setup(void) {
     display.addItem(DISP_SERVER, initPipe());
     display.addItem(DISP_CLIENT, initBlow());
     pCurDispItems = aDispItems + DISP_UNDEF;
-    display.addMenue(&mainMenu);
   } else {
     // We have an issue with the display, use LED to indicate it
     while (true) {
@@ -181,13 +307,9 @@ void setup(void) {
   pCurDispItems = aDispItems + DISP_UNDEF;
 
   if (CHECK(WITH_EEPROM)) {
-    eeprom.getBuffer(EEPROM_DEV_NAME,  aDevName,  sizeof(aDevName) - 1);
-    eeprom.getBuffer(EEPROM_PASSWORD,  aPassword, sizeof(aPassword) - 1);
-    eeprom.getBuffer(EEPROM_SSID_NAME, aSSID,     sizeof(aSSID) - 1);
-
-    aDevName[sizeof(aDevName) - 1] = 0;
-    aPassword[sizeof(aPassword) - 1] = 0;
-    aSSID[sizeof(aSSID) - 1] = 0;
+    cfg.getStr(REC_DEV_NAME,  aDevName,  sizeof(aDevName));
+    cfg.getStr(REC_PASSWORD,  aPassword, sizeof(aPassword));
+    cfg.getStr(REC_SSID_NAME, aSSID,     sizeof(aSSID));
 
     switch (aDevName[0]) {
       case 'b':
@@ -210,27 +332,29 @@ void setup(void) {
 
   int wifi_status = WL_NO_MODULE;
   if (CHECK(STATE_PIPE)) {
+    flightRec.begin(); // before the control core starts
     setupServerPipe(server, aDevName, aPassword, aIPaddress);
-    Udp.begin(1805); // Start UDP communication; wait for packages
+    Udp.begin(UDP_PORT); // Start UDP communication; wait for packages
   } else if (CHECK(STATE_BLOW)) {
     char aWaitStr[24];
     int connectCount = 1;
     WiFi.mode(WIFI_STA);
-    WiFi.setAutoReconnect(true);
+    WiFi.setAutoReconnect(false); // wifiLink reconnects, to the cached AP first
 
     sprintf(aIPaddress, "AP: %s", aSSID);
     pCurDispItems->pDevIP->setValue(aIPaddress);
-    do {
-      sprintf(aWaitStr, "WAIT %d", connectCount);
+    pCurDispItems->pError->setValue("WAIT");
+    display.refresh(displayIdx);
+    wifiLink.begin(aSSID, aPassword);
+    wifi_status = wifiLink.connectFast(); // no scan with the cached channel/BSSID
+    while (wifi_status == WL_NO_SSID_AVAIL || wifi_status == WL_DISCONNECTED) {
+      sprintf(aWaitStr, "WAIT %d", connectCount++);
       pCurDispItems->pError->setValue(aWaitStr);
       
       display.refresh(displayIdx);
 
-      WiFi.begin(aSSID, aPassword);
-      wifi_status = WiFi.waitForConnectResult(); // timeout 15 sec
-      if (wifi_status == WL_NO_SSID_AVAIL) {
-      }
-    } while (wifi_status == WL_NO_SSID_AVAIL || wifi_status == WL_DISCONNECTED);
+      wifi_status = wifiLink.connectScan();
+    }
 
     if (wifi_status == WL_CONNECTED) {
       setupClientBlow(server, aDevName, aPassword);
@@ -242,7 +366,7 @@ void setup(void) {
     }
     pCurDispItems->pDevIP->setValue(aIPaddress);
     pCurDispItems->pError->setValue("Connected");
-    Udp.begin(1805); // Start UDP communication, send packages
+    Udp.begin(UDP_PORT); // Start UDP communication, send packages
   } else {
     pCurDispItems->pDevTitle->updateText(aDevName);
     display.refresh(displayIdx);
@@ -256,7 +380,9 @@ void setup(void) {
   pCurDispItems->pDevIP->setValue(aIPaddress);
   pCurDispItems->pDevTitle->updateText(aDevName);
   display.refresh(displayIdx);
+  dispDirty.markAll();
   
+  startCores();
 }
 
 unsigned long lastTime = 0;
@@ -281,24 +407,30 @@ handleTouchSensor(sTouchSensor *pTS, bool pressed)
   if (pressed) { wasPressed |= (1 << pTS->pin); }
   else { wasPressed &= ~(1 << pTS->pin); }
 
+  // debounced press/release only, the pad states are shown on the boot screen
+  if (!CHECK(STATE_UNSET) || touchMenu.isOpen()) {
+    return 0;
+  }
   sprintf(aName, "0:%c 1:%c 2:%c", wasPressed & (1 << TOUCH0) ? 'P' : 'r', wasPressed & (1 << TOUCH1) ? 'P' : 'r', wasPressed & (1 << TOUCH2) ? 'P' : 'r');
   if (pCurDispItems && pCurDispItems->pDevTitle) {
-    pCurDispItems->pDevTitle->updateText(aName);
+    dispDirty.setText(pCurDispItems->pDevTitle, aName);
   }
   return 0;
 }
 
 void 
-toggleDisplay(unsigned long thisTime, int mv1, int mv2)
+toggleDisplay(unsigned long thisTime, int soc1, int soc2)
 {
   static int toggleDisplayTime;
   static bool state;
   
-  int toggle1 = mv1 < 3300 ? 0 : (mv1 < 9000 ? 200 : (mv1 < 10000 ? 500 : 0));
-  int toggle2 = mv2 < 3300 ? 0 : (mv2 < 5000 ? 200 : (mv2 <  6000 ? 500 : 0));
+  PROF_SCOPE(PROF_TOGGLE);
+  // -1: no pack (USB), no alarm
+  int toggle1 = soc1 < 0 ? 0 : (soc1 < BATT_ALARM_PCT ? 200 : (soc1 < BATT_WARN_PCT ? 500 : 0));
+  int toggle2 = soc2 < 0 ? 0 : (soc2 < BATT_ALARM_PCT ? 200 : (soc2 < BATT_WARN_PCT ? 500 : 0));
   
   if (toggle1 || toggle2 || state) {
-    int freq = toggle1 < toggle2 ? toggle1 : toggle2;
+    int freq = !toggle2 || (toggle1 && toggle1 < toggle2) ? toggle1 : toggle2; // the faster alarm
     if ((toggleDisplayTime + freq) < thisTime) {
       state = !state;
       display.invertDisplay(state);
@@ -308,6 +440,24 @@ toggleDisplay(unsigned long thisTime, int mv1, int mv2)
   }
 }
 
+#if RP2040W
+void setup1(void)
+{
+  while (!coresReady) {
+    delay(1);
+  }
+}
+
+void loop1(void)
+{
+  if (CHECK(WITH_DISPLAY) && ctrlTick.due(micros())) {
+    controlStep(micros());
+  } else if (power.isIdle()) {
+    delay(1); // sleep instead of spinning to the next idle tick
+  }
+}
+#endif
+
 void loop(void)
 {
   if (!CHECK(WITH_DISPLAY)) {
@@ -316,16 +466,20 @@ void loop(void)
     return;
   }
 
-  // read local data
-  sensor.Readout();
-  int pressure = sensor.GetPres() / 100;
-  int temp = 10*sensor.GetTemp();
-  int adc  = analogRead(ADC1);
-
-  switch (settingsFlags & (STATE_PIPE|STATE_BLOW|STATE_UNSET)) {
-  case STATE_PIPE: handlePipe(pressure, temp, adc); break;
-  case STATE_BLOW: handleBlow(pressure, temp, adc); break;
-  default:
-  case STATE_UNSET: handleUnset(pressure, temp, adc); break;
+#if RP2040W
+  // core 0, together with the Wi-Fi
+  if (dispTick.due(micros())) {
+    displayStep();
+  } else if (power.isIdle()) {
+    delay(1);
   }
+#elif ESP32_S3
+  // core 1, the display task runs on core 0
+  unsigned long now = micros();
+  if (ctrlTick.due(now)) {
+    controlStep(now);
+  } else if (power.isIdle()) {
+    delay(1); // sleep instead of spinning to the next idle tick
+  }
+#endif
 }
@@ -0,0 +1,270 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Configuration record store on the M24C02
+ * The 256 bytes are two banks of 128 bytes, each one a log of records:
+ *   header: magic, schema version, generation (u16), crc8
+ *   record: id, len, data[len], crc8 over id, len and data
+ *   0xff as id marks the free space
+ * The bank with the valid header and the higher generation is active, the
+ * newest record of an id wins. A save appends one record to the active bank,
+ * a torn write fails the crc and the previous record stays in use. A full
+ * bank is compacted into the other one, its header is written last, so a
+ * power loss during compaction keeps the old bank.
+ * begin(): validate the cached EEPROM content (call after eeprom.readAll()),
+ *   migrates the legacy fixed offsets or formats an empty store
+ * get(id, pBuf, size)/getStr(id, pStr, size): newest record, -1/false if missing
+ * set(id, pBuf, len)/setStr(id, pStr): store a record if it changed
+ * getGeneration()/getBank()/getFree()/getMigrated(): store statistic
+ * get/set serialize on a cBusGuard, the writers are the display core (Wi-Fi
+ * channel), the web task (/reset, /params) and setup(), an append must not
+ * meet a second append or a compaction at the same free offset.
+ */
+#ifndef CFGSTORE_H
+#define CFGSTORE_H
+
+#define CFG_MAGIC       0xB5
+#define CFG_SCHEMA      1
+#define CFG_BANK_SIZE   128
+#define CFG_HEAD_SIZE   5
+#define CFG_REC_HEAD    2  // id, len
+#define CFG_REC_MAX     32 // data bytes per record
+#define CFG_MAX_ID      16
+#define CFG_FREE        0xff
+
+// record ids, never reuse a number for a different content
+#define REC_VERSION     1  // MAJOR, MINOR, PATCH (u16 LE)
+#define REC_DEV_NAME    2  // string: first character selects pipe/blow
+#define REC_PASSWORD    3
+#define REC_SSID_NAME   4
+#define REC_WIFI_AP     5  // blow: channel and BSSID of the pipe AP (sWifiAp)
+#define REC_PIPE_PARAM  6  // pipe: runtime control parameters differing from the defaults (params.h)
+
+// fixed offsets used before the record store
+#define LEGACY_DEV_NAME  16
+#define LEGACY_PASSWORD  (LEGACY_DEV_NAME + 16)
+#define LEGACY_SSID_NAME (LEGACY_PASSWORD + 16)
+#define LEGACY_STR_SIZE  16
+
+class cCfgStore {
+    cM24C02 &eeprom;
+    int bank;         // offset of the active bank
+    uint16_t gen;
+    int freeOff;      // offset of the free space in the active bank
+    uint8_t aRec[CFG_MAX_ID];  // offset of the newest record per id, 0: none
+    bool migrated;
+    cBusGuard guard;  // get/set from both cores and the web task
+
+    static uint8_t crc8(uint8_t crc, const uint8_t *pBuf, int len) {
+        while (0 < len--) {
+            crc ^= *pBuf++;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+            }
+        }
+        return crc;
+    }
+
+    void readBytes(int addr, uint8_t *pBuf, int len) {
+        for (int idx = 0; idx < len; idx++) {
+            pBuf[idx] = eeprom.getByte(addr + idx);
+        }
+    }
+
+    // generation of a valid bank header, -1 otherwise
+    int headGen(int off) {
+        uint8_t aHead[CFG_HEAD_SIZE];
+        readBytes(off, aHead, CFG_HEAD_SIZE);
+        if (aHead[0] != CFG_MAGIC || aHead[1] != CFG_SCHEMA ||
+            crc8(0, aHead, CFG_HEAD_SIZE - 1) != aHead[CFG_HEAD_SIZE - 1]) {
+            return -1;
+        }
+        return aHead[2] | (aHead[3] << 8);
+    }
+
+    // index the records of the active bank
+    void scan() {
+        int off = bank + CFG_HEAD_SIZE;
+        int end = bank + CFG_BANK_SIZE;
+
+        memset(aRec, 0, sizeof(aRec));
+        while (off + CFG_REC_HEAD < end) {
+            int id = eeprom.getByte(off);
+            int len = eeprom.getByte(off + 1);
+            if (id == CFG_FREE) {
+                break;
+            }
+            if (CFG_REC_MAX < len || end < off + CFG_REC_HEAD + len + 1) {
+                off = end; // garbage, the next save compacts
+                break;
+            }
+            uint8_t aBuf[CFG_REC_HEAD + CFG_REC_MAX];
+            readBytes(off, aBuf, CFG_REC_HEAD + len);
+            if (id < CFG_MAX_ID && crc8(0, aBuf, CFG_REC_HEAD + len) == eeprom.getByte(off + CFG_REC_HEAD + len)) {
+                aRec[id] = off - bank;
+            } // else torn write, the older record of the id stays valid
+            off += CFG_REC_HEAD + len + 1;
+        }
+        freeOff = off - bank;
+    }
+
+    void writeHead(int off, uint16_t g) {
+        uint8_t aHead[CFG_HEAD_SIZE] = { CFG_MAGIC, CFG_SCHEMA, (uint8_t) g, (uint8_t) (g >> 8), 0 };
+        aHead[CFG_HEAD_SIZE - 1] = crc8(0, aHead, CFG_HEAD_SIZE - 1);
+        eeprom.setBuffer(off, aHead, CFG_HEAD_SIZE);
+    }
+
+    int writeRec(int off, int id, const uint8_t *pData, int len) {
+        uint8_t aBuf[CFG_REC_HEAD + CFG_REC_MAX + 1];
+        aBuf[0] = id;
+        aBuf[1] = len;
+        memcpy(aBuf + CFG_REC_HEAD, pData, len);
+        aBuf[CFG_REC_HEAD + len] = crc8(0, aBuf, CFG_REC_HEAD + len);
+        eeprom.setBuffer(off, aBuf, CFG_REC_HEAD + len + 1);
+        return CFG_REC_HEAD + len + 1;
+    }
+
+    // copy the newest records (replacing newId) into the other bank
+    bool compact(int newId, const uint8_t *pData, int len) {
+        int other = bank ? 0 : CFG_BANK_SIZE;
+        int off = other + CFG_HEAD_SIZE;
+        int need = CFG_REC_HEAD + len + 1;
+
+        for (int id = 0; id < CFG_MAX_ID; id++) {
+            if (aRec[id] && id != newId) {
+                need += CFG_REC_HEAD + eeprom.getByte(bank + aRec[id] + 1) + 1;
+            }
+        }
+        if (CFG_BANK_SIZE - CFG_HEAD_SIZE < need) {
+            return false;
+        }
+        eeprom.fill(other, CFG_FREE, CFG_BANK_SIZE); // header invalid until the end
+        for (int id = 0; id < CFG_MAX_ID; id++) {
+            if (aRec[id] && id != newId) {
+                uint8_t aBuf[CFG_REC_MAX];
+                int recLen = eeprom.getByte(bank + aRec[id] + 1);
+                readBytes(bank + aRec[id] + CFG_REC_HEAD, aBuf, recLen);
+                off += writeRec(off, id, aBuf, recLen);
+            }
+        }
+        if (pData) {
+            off += writeRec(off, newId, pData, len);
+        }
+        gen++;
+        writeHead(other, gen);
+        bank = other;
+        scan();
+        return true;
+    }
+
+    void format() {
+        bank = CFG_BANK_SIZE; // bank 0 may still hold the legacy layout
+        gen = 0;
+        eeprom.fill(bank, CFG_FREE, CFG_BANK_SIZE);
+        writeHead(bank, gen);
+        scan();
+    }
+
+    int read(int id, void *pBuf, int size) {
+        if (id < 0 || CFG_MAX_ID <= id || aRec[id] == 0) {
+            return -1;
+        }
+        int len = eeprom.getByte(bank + aRec[id] + 1);
+        len = len < size ? len : size;
+        readBytes(bank + aRec[id] + CFG_REC_HEAD, (uint8_t *) pBuf, len);
+        return len;
+    }
+
+    bool write(int id, const void *pBuf, int len) {
+        if (id < 0 || CFG_MAX_ID <= id || len < 0 || CFG_REC_MAX < len) {
+            return false;
+        }
+        if (aRec[id] && eeprom.getByte(bank + aRec[id] + 1) == len) {
+            uint8_t aOld[CFG_REC_MAX];
+            readBytes(bank + aRec[id] + CFG_REC_HEAD, aOld, len);
+            if (memcmp(aOld, pBuf, len) == 0) {
+                return true; // unchanged, no write
+            }
+        }
+        if (CFG_BANK_SIZE < freeOff + CFG_REC_HEAD + len + 1) {
+            return compact(id, (const uint8_t *) pBuf, len);
+        }
+        int off = freeOff;
+        freeOff += writeRec(bank + off, id, (const uint8_t *) pBuf, len);
+        aRec[id] = off;
+        return true;
+    }
+
+    void migrateStr(int recId, int legacyOff) {
+        char aStr[LEGACY_STR_SIZE + 1];
+        eeprom.getBuffer(legacyOff, aStr, LEGACY_STR_SIZE);
+        setStr(recId, aStr);
+    }
+
+    public:
+    cCfgStore(cM24C02 &e) : eeprom(e), bank(0), gen(0), freeOff(CFG_HEAD_SIZE), migrated(false) {
+        memset(aRec, 0, sizeof(aRec));
+    }
+
+    bool begin() {
+        int genA = headGen(0);
+        int genB = headGen(CFG_BANK_SIZE);
+
+        if (genA < 0 && genB < 0) {
+            int first = eeprom.getByte(LEGACY_DEV_NAME);
+            bool legacy = first == 'b' || first == 'B' || first == 'p' || first == 'P';
+            format();
+            if (legacy) {
+                migrateStr(REC_DEV_NAME, LEGACY_DEV_NAME);
+                migrateStr(REC_PASSWORD, LEGACY_PASSWORD);
+                migrateStr(REC_SSID_NAME, LEGACY_SSID_NAME);
+                migrated = true;
+            }
+            return false;
+        }
+        if (genB < 0 || (0 <= genA && 0 <= (int16_t) (genA - genB))) {
+            bank = 0;
+            gen = genA;
+        } else {
+            bank = CFG_BANK_SIZE;
+            gen = genB;
+        }
+        scan();
+        return true;
+    }
+
+    int get(int id, void *pBuf, int size) {
+        guard.lock();
+        int len = read(id, pBuf, size);
+        guard.unlock();
+        return len;
+    }
+
+    bool getStr(int id, char *pStr, int size) {
+        int len = get(id, pStr, size - 1);
+        pStr[len < 0 ? 0 : len] = 0;
+        return 0 <= len;
+    }
+
+    bool set(int id, const void *pBuf, int len) {
+        guard.lock();
+        bool ok = write(id, pBuf, len);
+        guard.unlock();
+        return ok;
+    }
+
+    bool setStr(int id, const char *pStr) {
+        return set(id, pStr, strnlen(pStr, CFG_REC_MAX));
+    }
+
+    uint16_t getGeneration() const { return gen; }
+    int getBank() const { return bank / CFG_BANK_SIZE; }
+    int getFree() const { return CFG_BANK_SIZE - freeOff; }
+    bool getMigrated() const { return migrated; }
+};
+
+#endif // CFGSTORE_H
@@ -13,33 +13,179 @@
 
 #define CLIENT_MBAR  apTxtIntItem[0]
 #define CLIENT_MVOLT apTxtIntItem[1]
+#define CLIENT_SOC   apTxtIntItem[2]
+#define CLIENT_MIN   apTxtIntItem[3]
 
 extern WiFiUDP Udp;
 
+cLinkStats blowStats;                // control core
+cLatest<sLinkSummary> blowStatsLink; // consumer: display core, the web page peek()s
+uint32_t blowLastRtt;                // control core, 0: sent already
+cClockSync blowClock;                // control core, pipe clock from the echoes
+cLatest<sClockState> blowClockLink;  // the web page peek()s
+std::atomic<uint32_t> blowFirstEcho(0); // ms after boot, the first sample reached the pipe
+
+// raw samples, only the baseline and the idle detection are used
+static const sFilterParam blowQuietParam = {
+    /* mode */ FILTER_NONE, /* cutoffHz */ 0, /* q */ 0, /* r */ 0, /* rateHz */ CTRL_RATE_HZ,
+    /* idleBand */ PRESS_IDLE_PA, /* idleMs */ 2000, /* baseShift */ 11, /* baseInit */ FILTER_BASE_INIT
+};
+
+void
+sendBlowPacket(sUDPPacket &pkt)
+{
+  static uint16_t seq;
+  uint8_t aBuf[V2_MAX_SIZE];
+
+  PROF_SCOPE(PROF_UDP_TX);
+  pkt.seq = seq++;
+  // lets the pipe keep the same statistic, every measurement goes out once
+  pkt.hasRtt = blowLastRtt != 0;
+  pkt.rtt = blowLastRtt;
+  blowLastRtt = 0;
+  pkt.hasClock = blowClock.isSynced(); // lets the pipe age the samples on its clock
+  if (pkt.hasClock) {
+    uint32_t err = blowClock.getDelay() / 2;
+    pkt.offset = blowClock.offsetAt(pkt.aSample[0].time);
+    pkt.clockErr = err < 0xffff ? err : 0xffff;
+  }
+  int len = udpEncodeV2(aBuf, pkt);
+  blowStats.onSend(pkt.seq, micros());
+  Udp.beginPacket(serverAddr, UDP_PORT);
+  Udp.write(aBuf, len);
+  Udp.endPacket();
+  pkt.count = 0;
+  pkt.hasStatus = false;
+}
+
+// echoes of the pipe, returns true if a new round trip time was measured
+bool
+drainBlowEcho()
+{
+  bool gotRtt = false;
+
+  PROF_SCOPE(PROF_UDP_RX);
+  while (0 < Udp.parsePacket()) {
+    uint8_t aBuf[ECHO_SIZE];
+    sUDPEcho echo;
+    int n = Udp.read(aBuf, sizeof(aBuf));
+    uint32_t now = micros();
+    if (udpDecodeEcho(aBuf, n, echo)) {
+      uint32_t rtt = blowStats.onEcho(echo.seq, now);
+      if (rtt) {
+        blowLastRtt = rtt;
+        blowClock.add(now - rtt, echo.rxTime, echo.txTime, now);
+        gotRtt = true;
+        if (!blowFirstEcho.load(std::memory_order_relaxed)) {
+          blowFirstEcho = millis();
+        }
+      }
+    }
+  }
+  return gotRtt;
+}
+
+// control tick: sample and send
 void
-handleBlow(int pressure, int temp, int adc)
+handleBlow(const sLocalState &local, int adc)
 {
   static unsigned long lastTime;
-  uint16_t aPackage[4];
+  static cPressFilter quiet(blowQuietParam);
   unsigned long thisTime = millis();
-  int mV = ADC2MV(adc);
 
+  if (local.presPa) {
+    quiet.update(local.presPa, thisTime);
+  }
+  power.update(quiet.isReady() && quiet.isIdle(), thisTime);
+
+#if UDP_PROTO == 1
   if (250 < (thisTime - lastTime)) {
     // Send UDP package
     uint16_t aPackage[4];
     lastTime = thisTime;
     aPackage[0] = VAL_TIME  | ((lastTime >> 8) & 0xfff);
     aPackage[1] = VAL_MVOLT | (adc & 0xfff);
-    aPackage[2] = VAL_MBAR  | pressure;
-    aPackage[3] = VAL_TEMP  | temp;
-    pCurDispItems->CLIENT_MBAR->setValue(pressure); // mBar
-    pCurDispItems->CLIENT_MVOLT->setValue(mV); // mV
-    Udp.beginPacket(serverAddr, 1805);
+    aPackage[2] = VAL_MBAR  | local.pressure;
+    aPackage[3] = VAL_TEMP  | local.temp;
+    Udp.beginPacket(serverAddr, UDP_PORT);
     Udp.write((const uint8_t *) aPackage, 4*sizeof(aPackage[0]));
     Udp.endPacket();
-    
-    toggleDisplay(thisTime, 0, mV);
-    display.refresh(displayIdx);
+  }
+#else
+  static cTick sampleTick(BLOW_SAMPLE_HZ);
+  static sUDPPacket pkt;
+  static bool sampleIdle;
+  unsigned long now = micros();
+  bool idle = power.isIdle();
+
+  if (drainBlowEcho()) {
+    sLinkSummary link;
+    sClockState clock;
+    blowStats.summary(link);
+    blowStatsLink.put(link);
+    blowClock.getState(clock);
+    blowClockLink.put(clock);
+  }
+  if (idle != sampleIdle) {
+    sampleIdle = idle;
+    sampleTick.adjustRate(idle ? BLOW_IDLE_HZ : BLOW_SAMPLE_HZ);
+  }
+  if (!sampleTick.due(now) || local.presPa == 0) {
+    return; // 0: the sensor has no conversion yet, the pipe would learn it as baseline
+  }
+
+  sUDPSample sample = { (uint32_t) now, local.presPa };
+  if (!udpFitsV2(pkt, sample)) {
+    sendBlowPacket(pkt);
+  }
+  pkt.aSample[pkt.count++] = sample;
+
+  // battery and temperature only at a low rate
+  if (BLOW_STATUS_MS < (thisTime - lastTime)) {
+    lastTime = thisTime;
+    pkt.hasStatus = true;
+    pkt.mvolt = local.mV;
+    pkt.temp = local.temp;
+  }
+  if ((idle ? 1 : BLOW_BATCH) <= pkt.count) {
+    sendBlowPacket(pkt); // idle: no batching, every sample keeps the pipe link up
+  }
+#endif
+}
+
+// display tick
+void
+displayBlow(const sLocalState &local)
+{
+  dispDirty.setInt(pCurDispItems->CLIENT_MBAR, local.pressure); // mBar
+  dispDirty.setInt(pCurDispItems->CLIENT_MVOLT, local.mV); // mV
+  dispDirty.setInt(pCurDispItems->CLIENT_SOC, local.soc);
+  dispDirty.setInt(pCurDispItems->CLIENT_MIN, local.minutes);
+  static sLinkSummary blowStatsShown;
+  blowStatsLink.get(blowStatsShown);
+  wifiLink.poll(millis());
+  if (!wifiLink.isUp()) {
+    dispDirty.setStr(pCurDispItems->pError, "NO WIFI");
+  } else if (blowStatsShown.samples) {
+    char aMsg[16];
+    getLinkShort(aMsg, blowStatsShown);
+    dispDirty.setStr(pCurDispItems->pError, aMsg);
+  }
+  toggleDisplay(millis(), -1, local.soc);
+  PROF_START(PROF_REFRESH);
+  dispDirty.refresh(display, displayIdx, millis());
+  PROF_STOP(PROF_REFRESH);
+
+  if (telemetry.due(millis())) {
+    PROF_SCOPE(PROF_TELEM);
+    char aJson[TELEM_JSON_SIZE];
+    snprintf(aJson, sizeof(aJson),
+             "{\"local\":%d,\"pressurePa\":%ld,\"mV\":%d,\"soc\":%d,\"min\":%d,\"temp\":%d,\"rttP50\":%lu,\"rttP99\":%lu,"
+             "\"lateAvg\":%lu,\"lateMax\":%lu}",
+             local.pressure, (long) local.presPa, local.mV, local.soc, local.minutes, local.temp,
+             (unsigned long) blowStatsShown.p50, (unsigned long) blowStatsShown.p99,
+             ctrlTick.getLateAvg(), ctrlTick.getLateMax());
+    telemetry.send(aJson);
   }
 }
 
@@ -50,8 +196,10 @@ initBlow()
     cDisplayItem *pRet = genDefaultItems(pCurDispItems, "CLIENT");
     cDisplayItem *pPrev = pRet;
 
-    pPrev = pCurDispItems->CLIENT_MBAR  = new cTextIntItem(0, 3*8, "loc: %4d mBar", pPrev);
-    pPrev = pCurDispItems->CLIENT_MVOLT = new cTextIntItem(0, 4*8, " mV: %4d mV", pPrev);
+    pPrev = pCurDispItems->CLIENT_MBAR  = dispDirty.track(new cTextIntItem(0, 3*8, "loc: %4d mBar", pPrev));
+    pPrev = pCurDispItems->CLIENT_MVOLT = dispDirty.track(new cTextIntItem(0, 4*8, " mV: %4d mV", pPrev));
+    pPrev = pCurDispItems->CLIENT_SOC   = dispDirty.track(new cTextIntItem(0, 5*8, "Bat: %4d %%", pPrev));
+    pPrev = pCurDispItems->CLIENT_MIN   = dispDirty.track(new cTextIntItem(0, 6*8, "Run: %4d min", pPrev));
 
     return pRet;
 }
@@ -77,7 +225,7 @@ void setupClientBlow(AsyncWebServer &server, const char *pHost, const char *pPas
         "<h1>Reset and Reboot</h1>"
         "</body>"
         "</html>";
-    static const char* serverIndex = 
+    static const char* serverIndexHead = 
     "<!DOCTYPE HTML>"
     "<html>"
     "<head>"
@@ -87,27 +235,70 @@ void setupClientBlow(AsyncWebServer &server, const char *pHost, const char *pPas
     "<body>"
       "<h1>Blow Client</h1>"
     "<form method='POST' action='/update' enctype='multipart/form-data'>"
+        "<input type='text' name='sha256' size='64' placeholder='sha256 of the image'>"
         "<input type='file' name='update'>"
         "<input type='submit' value='Update'>"
     "</form>"
     "<form method='GET' action='/reset' enctype='multipart/form-data'>"
     "<input type='submit' value='Reset'>"
+    "<br>";
+    static const char* serverIndexTail = 
     "</body>"
     "</html>";
 
     MDNS.begin(pHost);
+    setupLive(server, "Blow live");
+    setupStats(server);
     server.on("/",
         HTTP_GET,
-        [](AsyncWebServerRequest *pReq) { pReq->send(200, "text/html", serverIndex);}
+        [](AsyncWebServerRequest *pReq) {
+            char aTick[160];
+            String page = serverIndexHead;
+            sLinkSummary blowStatsShown; // the web task reads the control core snapshots itself
+            sClockState blowClockShown;
+            blowStatsLink.peek(blowStatsShown);
+            blowClockLink.peek(blowClockShown);
+            getTickStatus(aTick);
+            page += aTick;
+            page += "<br>";
+            getDispStatus(aTick);
+            page += aTick;
+            page += "<br>";
+            getLinkStatus(aTick, "Link", blowStatsShown);
+            page += aTick;
+            page += "<br>";
+            getTelemetryStatus(aTick);
+            page += aTick;
+            page += "<br>";
+            power.getStatus(aTick);
+            page += aTick;
+            page += "<br>";
+            battery.getStatus(aTick, "Battery");
+            page += aTick;
+            page += "<br>";
+            adcScan.getStatus(aTick);
+            page += aTick;
+            page += "<br>";
+            wifiLink.getStatus(aTick);
+            page += aTick;
+            sprintf(aTick, ", first sample at the pipe %lu ms after boot", (unsigned long) blowFirstEcho.load());
+            page += aTick;
+            sprintf(aTick, "<br>Clock: %s, pipe offset %ld us, delay %lu us, drift %ld ppm, %lu exchanges",
+                    blowClockShown.synced ? "synced" : "not synced", (long) blowClockShown.offset,
+                    (unsigned long) blowClockShown.delay, (long) blowClockShown.drift / 16,
+                    (unsigned long) blowClockShown.exchanges);
+            page += aTick;
+            page += serverIndexTail;
+            pReq->send(200, "text/html", page);
+        }
     );
 
     server.on("/reset",
         HTTP_GET,
         [](AsyncWebServerRequest *pReq) { 
-            uint8_t aEmpty[1] = {0};
-            eeprom.setBuffer(EEPROM_DEV_NAME, aEmpty, 1);
-            eeprom.setBuffer(EEPROM_PASSWORD, aEmpty, 1);
-            eeprom.setBuffer(EEPROM_SSID_NAME, aEmpty, 1);
+            cfg.setStr(REC_DEV_NAME, "");
+            cfg.setStr(REC_PASSWORD, "");
+            cfg.setStr(REC_SSID_NAME, "");
             pReq->send(200, "text/plain", "OK, restarting...");
             delay(1000);
             DORESTART;
@@ -123,10 +314,9 @@ void setupClientBlow(AsyncWebServer &server, const char *pHost, const char *pPas
         "/reset",
         HTTP_GET, 
         [](AsyncWebServerRequest *pReq) {
-            uint8_t aEmpty[2] = {0xff, 0xff};
             pReq->send(200, "text/html", serverResetAndReboot);
             delay(100);
-            eeprom.setBuffer(EEPROM_DEV_NAME, aEmpty, 2);
+            cfg.setStr(REC_DEV_NAME, "");
             DORESTART;
         }
     );
@@ -0,0 +1,143 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Offset and drift of the remote micros() clock, NTP style
+ * add(t1, t2, t3, t4): one exchange, t1/t4 local send/receive, t2/t3 remote
+ *   receive/send time of the echo
+ *   offset = ((t2 - t1) + (t3 - t4)) / 2, delay = (t4 - t1) - (t3 - t2)
+ *   Of the last CLOCK_FILTER exchanges the one with the smallest delay is used,
+ *   queueing on either side only adds delay and makes the offset asymmetric.
+ *   The drift is the slope between the best exchanges of two consecutive
+ *   windows of CLOCK_DRIFT_US, those have the least queueing over a long time.
+ * offsetAt(t): remote - local clock at local time t, drift corrected
+ * toRemote(t): local time t on the remote clock
+ * isSynced(), getDelay(), getDrift() (1/16 ppm), getState(s)
+ * Only depends on stdint.h so it can be compiled into the host simulation.
+ */
+#ifndef CLOCKSYNC_H
+#define CLOCKSYNC_H
+
+#include <stdint.h>
+
+#define CLOCK_FILTER       8        // exchanges in the minimum delay filter
+#define CLOCK_DRIFT_US     16000000 // window for the drift estimate
+#define CLOCK_DRIFT_MAX    (500*16) // 500 ppm, beyond that the remote restarted
+
+struct sClockState {
+    bool synced;
+    int32_t offset;  // us, remote - local
+    uint32_t delay;  // us, round trip without the remote processing time
+    int32_t drift;   // 1/16 ppm
+    uint32_t exchanges;
+};
+
+class cClockSync {
+    struct sExchange {
+        int32_t offset;
+        uint32_t delay;
+        uint32_t time; // local time of the exchange midpoint
+    } aEx[CLOCK_FILTER];
+    int count;
+    int next;
+    int32_t offset;
+    uint32_t delay;
+    uint32_t refTime;
+    int32_t drift;
+    sExchange winBest;   // best exchange of the current drift window
+    uint32_t winStart;
+    sExchange prevBest;  // best exchange of the previous window
+    bool havePrev;
+    bool synced;
+    uint32_t exchanges;
+    public:
+    cClockSync() { reset(); }
+
+    void reset() {
+        count = 0;
+        next = 0;
+        offset = 0;
+        delay = 0;
+        refTime = 0;
+        drift = 0;
+        havePrev = false;
+        synced = false;
+        exchanges = 0;
+    }
+
+    void add(uint32_t t1, uint32_t t2, uint32_t t3, uint32_t t4) {
+        uint32_t busy = t3 - t2;
+        uint32_t rtt = t4 - t1;
+        aEx[next].delay = busy < rtt ? rtt - busy : 0;
+        aEx[next].offset = ((int32_t) (t2 - t1) + (int32_t) (t3 - t4)) / 2;
+        aEx[next].time = t1 + rtt / 2;
+        next = (next + 1) % CLOCK_FILTER;
+        count += count < CLOCK_FILTER ? 1 : 0;
+        exchanges++;
+        updateDrift(aEx[(next + CLOCK_FILTER - 1) % CLOCK_FILTER]);
+
+        const sExchange *pBest = aEx;
+        for (int idx = 1; idx < count; idx++) {
+            if (aEx[idx].delay < pBest->delay) {
+                pBest = aEx + idx;
+            }
+        }
+        if (synced && pBest->time == refTime) {
+            return; // still the same best exchange
+        }
+        offset = pBest->offset;
+        delay = pBest->delay;
+        refTime = pBest->time;
+        synced = true;
+    }
+
+    void updateDrift(const sExchange &ex) {
+        if (exchanges == 1) {
+            winBest = ex;
+            winStart = ex.time;
+            return;
+        }
+        if (ex.delay < winBest.delay) {
+            winBest = ex;
+        }
+        if ((int32_t) (ex.time - winStart) < CLOCK_DRIFT_US) {
+            return;
+        }
+        if (havePrev) {
+            int32_t dt = winBest.time - prevBest.time;
+            int32_t slope = (int32_t) ((int64_t) (winBest.offset - prevBest.offset) * 16000000 / dt);
+            if (-CLOCK_DRIFT_MAX < slope && slope < CLOCK_DRIFT_MAX) {
+                drift += (slope - drift) / 2;
+            } else {
+                drift = 0; // offset jumped, the remote restarted
+            }
+        }
+        prevBest = winBest;
+        havePrev = true;
+        winBest = ex;
+        winStart = ex.time;
+    }
+
+    int32_t offsetAt(uint32_t t) const {
+        return offset + (int32_t) ((int64_t) drift * (int32_t) (t - refTime) / 16000000);
+    }
+
+    uint32_t toRemote(uint32_t t) const { return t + offsetAt(t); }
+
+    bool isSynced() const { return synced; }
+    uint32_t getDelay() const { return delay; }
+    int32_t getDrift() const { return drift; }
+
+    void getState(sClockState &s) const {
+        s.synced = synced;
+        s.offset = offset;
+        s.delay = delay;
+        s.drift = drift;
+        s.exchanges = exchanges;
+    }
+};
+
+#endif // CLOCKSYNC_H
@@ -0,0 +1,110 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Lock free exchange between the control core and the display/web core
+ * cLatest<T>: single producer / single consumer mailbox for state snapshots
+ *   put(val): producer side, never waits, overwrites the previous snapshot
+ *   get(val): consumer side, copies the newest snapshot, false if nothing new
+ *   peek(val): any other reader (web handlers), copies the newest snapshot
+ *     without touching the state of the consumer, false before the first put
+ *   Sequence lock: only plain loads/stores, works on the Cortex-M0+ as well
+ * cSpscRing<T, N>: single producer / single consumer FIFO for events, N a
+ *   power of two, the producer may be an interrupt handler
+ *   push(val): producer side, never waits, false when full (val is dropped)
+ *   pop(val): consumer side, false when empty
+ * cBusGuard: try-lock for an I2C bus used from both cores, the control core
+ *   only uses tryLock() and skips the access instead of waiting
+ */
+#ifndef CORELINK_H
+#define CORELINK_H
+
+#include <atomic>
+
+template <typename T>
+class cLatest {
+    T val;
+    std::atomic<unsigned> seq;  // odd while the producer writes
+    unsigned readSeq;           // consumer only
+    public:
+    cLatest() : seq(0), readSeq(0) {}
+
+    void put(const T &v) {
+        unsigned s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        val = v;
+        std::atomic_thread_fence(std::memory_order_release);
+        seq.store(s + 2, std::memory_order_relaxed);
+    }
+
+    bool get(T &v) {
+        unsigned s1, s2;
+        do {
+            s1 = seq.load(std::memory_order_acquire);
+            if (s1 == readSeq) {
+                return false; // nothing new
+            }
+            v = val;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            s2 = seq.load(std::memory_order_relaxed);
+        } while ((s1 & 1) || s1 != s2); // torn copy, the producer was writing
+        readSeq = s1;
+        return true;
+    }
+
+    bool peek(T &v) const {
+        unsigned s1, s2;
+        do {
+            s1 = seq.load(std::memory_order_acquire);
+            v = val;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            s2 = seq.load(std::memory_order_relaxed);
+        } while ((s1 & 1) || s1 != s2);
+        return s1 != 0;
+    }
+};
+
+template <typename T, unsigned N>
+class cSpscRing {
+    static_assert((N & (N - 1)) == 0, "N must be a power of two");
+    T aVal[N];
+    std::atomic<unsigned> head; // next write, producer only
+    std::atomic<unsigned> tail; // next read, consumer only
+    public:
+    cSpscRing() : head(0), tail(0) {}
+
+    bool push(const T &v) {
+        unsigned h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+        aVal[h % N] = v;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &v) {
+        unsigned t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        v = aVal[t % N];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+class cBusGuard {
+    std::atomic<bool> busy;
+    public:
+    cBusGuard() : busy(false) {}
+    bool tryLock() { return !busy.exchange(true, std::memory_order_acquire); }
+    void lock() { while (!tryLock()) { yield(); } }
+    void unlock() { busy.store(false, std::memory_order_release); }
+};
+
+#endif // CORELINK_H
@@ -0,0 +1,85 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Fixed rate tick on the micros() timer
+ * cTick(rateHz): set up a tick with the given rate
+ * due(now): true once per period, the schedule is kept on a fixed grid so
+ *   a late tick does not shift the following ones
+ * setRate(rateHz): change the rate, restarts the schedule
+ * adjustRate(rateHz): change the rate, the next tick is one new period after
+ *   the last one, keeps the statistic
+ * getLateAvg()/getLateMax(): measured jitter (tick start after the ideal time) in us
+ * getMissed(): number of periods skipped because the loop was stalled
+ * resetStats(): clear the jitter statistic
+ */
+#ifndef CTRLTICK_H
+#define CTRLTICK_H
+
+class cTick {
+    unsigned long period;
+    unsigned long next;
+    unsigned long lateMax;
+    unsigned long lateSum;
+    unsigned long count;
+    unsigned long missed;
+    bool started;
+    public:
+    cTick(unsigned int rateHz) {
+        setRate(rateHz);
+    }
+
+    void setRate(unsigned int rateHz) {
+        period = 1000000UL / (rateHz ? rateHz : 1);
+        started = false;
+        resetStats();
+    }
+
+    void adjustRate(unsigned int rateHz) {
+        unsigned long newPeriod = 1000000UL / (rateHz ? rateHz : 1);
+        next += newPeriod - period;
+        period = newPeriod;
+    }
+
+    void resetStats() {
+        lateMax = 0;
+        lateSum = 0;
+        count = 0;
+        missed = 0;
+    }
+
+    bool due(unsigned long now) {
+        if (!started) {
+            started = true;
+            next = now;
+        }
+        if ((long) (now - next) < 0) {
+            return false;
+        }
+        unsigned long late = now - next;
+        if (period <= late) {
+            // stalled for more than a period, restart the grid instead of
+            // firing a burst of catch up ticks
+            missed += late / period;
+            late %= period;
+            next = now - late;
+        }
+        next += period;
+        lateMax = late > lateMax ? late : lateMax;
+        lateSum += late;
+        count++;
+        return true;
+    }
+
+    unsigned long getPeriod() const { return period; }
+    unsigned long getRate() const { return 1000000UL / period; }
+    unsigned long getLateMax() const { return lateMax; }
+    unsigned long getLateAvg() const { return count ? lateSum / count : 0; }
+    unsigned long getCount() const { return count; }
+    unsigned long getMissed() const { return missed; }
+};
+
+#endif // CTRLTICK_H
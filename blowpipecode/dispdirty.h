@@ -0,0 +1,146 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Dirty tracking for the display item chain
+ * track(pItem): register an item
+ * setInt/setStr/setText/setIcon(pItem, val): update the item only if the value
+ *   changed, marks the frame dirty
+ * markAll(): force the next refresh, e.g. after a screen change
+ * refresh(display, idx, now): push a frame only if an item changed and the
+ *   frame rate cap allows it, returns true if a frame was sent
+ * cDisplay renders and sends the whole frame in refresh(idx), it has no call
+ * for a part of it and no access to its frame buffer, so an unchanged screen
+ * costs no bus time, a changed one always the full frame.
+ * getFrames()/getSkipped()/getFramesPerSec(): frames sent, held back by the
+ *   cap, sent in the last second
+ */
+#ifndef DISPDIRTY_H
+#define DISPDIRTY_H
+
+#define DIRTY_MAX_ITEMS 40
+
+class cDispDirty {
+    struct sEntry {
+        const void *pItem;
+        int32_t last;
+        bool valid;
+    } aEntry[DIRTY_MAX_ITEMS];
+    int count;
+    bool dirty;
+    unsigned long minInterval;
+    unsigned long lastFrame;
+    unsigned long secStart;
+    uint32_t secFrames;
+    uint32_t framesPerSec;
+    uint32_t frames;
+    uint32_t skipped;
+
+    sEntry *find(const void *pItem) {
+        for (int idx = 0; idx < count; idx++) {
+            if (aEntry[idx].pItem == pItem) {
+                return aEntry + idx;
+            }
+        }
+        return nullptr;
+    }
+
+    bool changed(const void *pItem, int32_t val) {
+        sEntry *pE = find(pItem);
+        if (pE == nullptr) {
+            dirty = true; // untracked item, always written
+            return true;
+        }
+        if (pE->valid && pE->last == val) {
+            return false;
+        }
+        pE->last = val;
+        pE->valid = true;
+        dirty = true;
+        return true;
+    }
+
+    static int32_t hash(const char *pStr) {
+        uint32_t h = 2166136261u; // FNV-1a
+        while (*pStr) {
+            h = (h ^ (uint8_t) *pStr++) * 16777619u;
+        }
+        return (int32_t) h;
+    }
+
+    public:
+    cDispDirty(unsigned int maxFps) {
+        count = 0;
+        dirty = true;
+        minInterval = 1000 / (maxFps ? maxFps : 1);
+        lastFrame = 0;
+        secStart = 0;
+        secFrames = 0;
+        framesPerSec = 0;
+        frames = 0;
+        skipped = 0;
+    }
+
+    template <class T>
+    T *track(T *pItem) {
+        if (count < DIRTY_MAX_ITEMS) {
+            aEntry[count].pItem = pItem;
+            aEntry[count].valid = false;
+            count++;
+        }
+        return pItem;
+    }
+
+    void setInt(cTextIntItem *pItem, int val) {
+        if (changed(pItem, val)) {
+            pItem->setValue(val);
+        }
+    }
+    void setStr(cTextStrItem *pItem, const char *pVal) {
+        if (changed(pItem, hash(pVal))) {
+            pItem->setValue(pVal);
+        }
+    }
+    void setText(cTextItem *pItem, const char *pVal) {
+        if (changed(pItem, hash(pVal))) {
+            pItem->updateText(pVal);
+        }
+    }
+    void setIcon(cIconItem *pItem, const uint8_t *pIcon) {
+        if (changed(pItem, (int32_t) (intptr_t) pIcon)) {
+            pItem->setValue(pIcon);
+        }
+    }
+
+    void markAll() { dirty = true; }
+
+    bool refresh(cDisplay &disp, int idx, unsigned long now) {
+        if (now - secStart >= 1000) {
+            framesPerSec = secFrames;
+            secFrames = 0;
+            secStart = now;
+        }
+        if (!dirty) {
+            return false;
+        }
+        if (now - lastFrame < minInterval) {
+            skipped++;
+            return false; // frame rate cap, stays dirty
+        }
+        disp.refresh(idx); // the whole frame
+        secFrames++;
+        dirty = false;
+        lastFrame = now;
+        frames++;
+        return true;
+    }
+
+    uint32_t getFramesPerSec() const { return framesPerSec; }
+    uint32_t getFrames() const { return frames; }
+    uint32_t getSkipped() const { return skipped; }
+};
+
+#endif // DISPDIRTY_H
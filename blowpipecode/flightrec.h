@@ -0,0 +1,184 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Flight recorder: every control tick of the pipe as a frecord.h block log on LittleFS
+ * cFlightRec:
+ *   begin(): mount LittleFS, continue after the newest session in a new file
+ *   add(sample): control core, encodes into the RAM stage, no file access
+ *   flush(quiet): display core, only while the pipe is quiet, writes up to
+ *     FREC_FLUSH_MAX completed blocks, one flash page each
+ *   getStatus(pBuffer): session, file, size, staged blocks, dropped records
+ *     and slowest write
+ * Rotation: FREC_FILES files /rec0.bin.. of up to FREC_FILE_KB, every boot and
+ *   every full file opens the next one, the oldest recording is overwritten.
+ * Every flash program or erase pauses the other core as well (RP2040W: XIP,
+ *   ESP32_S3: the flash cache is off on both CPUs), a 4 KB sector erase of
+ *   LittleFS takes tens of ms. So nothing is written while the pipe controls:
+ *   the FREC_STAGE blocks hold the ticks in RAM until the pipe is quiet
+ *   (idle mode or stopped in the menu, motor and vent off), a longer active
+ *   stretch drops records instead of stalling the control core. The staged
+ *   blocks are lost at a power cut. sim/firmsim measures the pauses.
+ * setupRecorder(server): /rec lists the files, /rec?file=N downloads one,
+ *   decode it with sim/frecdump
+ */
+#ifndef FLIGHTREC_H
+#define FLIGHTREC_H
+
+#include "frecord.h"
+
+class cFlightRec {
+    cFrecStage stage;
+    File file;
+    bool ready;
+    int fileIdx;
+    uint16_t session;
+    uint32_t fileBytes;
+    uint32_t blocks;
+    uint32_t writeMax; // us
+    bool writeError;
+
+    void openFile() {
+        char aPath[16];
+        getPath(aPath, fileIdx);
+        file = LittleFS.open(aPath, "w"); // truncates the oldest recording
+        fileBytes = 0;
+    }
+
+    public:
+    cFlightRec() : ready(false), fileIdx(0), session(0), fileBytes(0), blocks(0), writeMax(0), writeError(false) {}
+
+    static void getPath(char *pBuffer, int idx) { sprintf(pBuffer, "/rec%d.bin", idx); }
+
+    bool begin() {
+#if ESP32_S3
+        bool mounted = LittleFS.begin(true); // formats an empty partition
+#else
+        bool mounted = LittleFS.begin();
+#endif
+        if (!mounted) {
+            return false;
+        }
+        int newest = -1;
+        uint16_t seq = 0;
+        for (int idx = 0; idx < FREC_FILES; idx++) {
+            char aPath[16];
+            uint8_t aHead[FREC_HEAD];
+            cFrecDecoder dec;
+            getPath(aPath, idx);
+            if (!LittleFS.exists(aPath)) {
+                continue;
+            }
+            File f = LittleFS.open(aPath, "r");
+            // a session continues over several files, the newest one has the highest seq
+            if (f && f.read(aHead, FREC_HEAD) == FREC_HEAD && dec.start(aHead) &&
+                (newest < 0 || 0 < (int16_t) (dec.head.session - session) ||
+                 (dec.head.session == session && 0 < (int16_t) (dec.head.seq - seq)))) {
+                newest = idx;
+                session = dec.head.session;
+                seq = dec.head.seq;
+            }
+            f.close();
+        }
+        fileIdx = newest < 0 ? 0 : (newest + 1) % FREC_FILES;
+        session = newest < 0 ? 0 : session + 1;
+        stage.setSession(session);
+        openFile();
+        ready = file;
+        return ready;
+    }
+
+    void add(const sFrecSample &s) {
+        if (ready) {
+            stage.add(s);
+        }
+    }
+
+    void flush(bool quiet) {
+        const uint8_t *pBlock;
+        int written = 0;
+
+        while (quiet && ready && written < FREC_FLUSH_MAX && (pBlock = stage.peek()) != nullptr) {
+            if (FREC_FILE_KB * 1024 < fileBytes + FREC_BLOCK) {
+                file.close();
+                fileIdx = (fileIdx + 1) % FREC_FILES;
+                openFile();
+            }
+            unsigned long start = micros();
+            if (file.write(pBlock, FREC_BLOCK) != FREC_BLOCK) {
+                writeError = true; // file system full, keep the recording so far
+                ready = false;
+            }
+            unsigned long used = micros() - start;
+            writeMax = used < writeMax ? writeMax : used;
+            fileBytes += FREC_BLOCK;
+            blocks++;
+            written++;
+            stage.pop();
+        }
+        if (written) {
+            file.flush(); // visible to a download
+        }
+    }
+
+    int getFile() const { return fileIdx; }
+
+    void getStatus(char *pBuffer) {
+        sprintf(pBuffer, "Recorder: %s, session %u, file %d, %lu KB, %u blocks staged, %lu records, %lu dropped, write max %lu us",
+                ready ? "on" : (writeError ? "write error" : "off"), session, fileIdx,
+                (unsigned long) (fileBytes / 1024), stage.getStaged(), (unsigned long) stage.getRecords(),
+                (unsigned long) stage.getDropped(), (unsigned long) writeMax);
+    }
+};
+
+extern cFlightRec flightRec;
+
+void
+setupRecorder(AsyncWebServer &server)
+{
+    server.on("/rec", HTTP_GET, [](AsyncWebServerRequest *pReq) {
+        char aPath[16];
+        if (pReq->hasParam("file")) {
+            int idx = pReq->getParam("file")->value().toInt();
+            File f;
+            flightRec.getPath(aPath, idx);
+            if (idx < 0 || FREC_FILES <= idx || !LittleFS.exists(aPath) || !(f = LittleFS.open(aPath, "r"))) {
+                pReq->send(404, "text/plain", "no recording");
+                return;
+            }
+            // stateless filler, the file handle lives as long as the response
+            AsyncWebServerResponse *pResp = pReq->beginChunkedResponse("application/octet-stream",
+                [f](uint8_t *pBuf, size_t maxLen, size_t index) mutable -> size_t {
+                    f.seek(index);
+                    return f.read(pBuf, maxLen);
+                });
+            char aDisp[48];
+            sprintf(aDisp, "attachment; filename=\"%s\"", aPath + 1);
+            pResp->addHeader("Content-Disposition", aDisp);
+            pReq->send(pResp);
+            return;
+        }
+        char aLine[160];
+        String page = "<!DOCTYPE HTML><html><head><title>Recordings</title></head><body><h1>Recordings</h1>";
+        flightRec.getStatus(aLine);
+        page += aLine;
+        page += "<ul>";
+        for (int idx = 0; idx < FREC_FILES; idx++) {
+            flightRec.getPath(aPath, idx);
+            if (LittleFS.exists(aPath)) {
+                File f = LittleFS.open(aPath, "r");
+                sprintf(aLine, "<li><a href='/rec?file=%d'>%s</a> %lu bytes%s</li>", idx, aPath + 1,
+                        (unsigned long) f.size(), idx == flightRec.getFile() ? " (recording)" : "");
+                f.close();
+                page += aLine;
+            }
+        }
+        page += "</ul></body></html>";
+        pReq->send(200, "text/html", page);
+    });
+}
+
+#endif // FLIGHTREC_H
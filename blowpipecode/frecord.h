@@ -0,0 +1,265 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Flight recorder format and RAM staging, no file access (used by sim/frecdump too)
+ * A recording is a sequence of FREC_BLOCK sized blocks, every block decodes
+ * on its own:
+ *   header (FREC_HEAD bytes, little endian):
+ *     magic, version, session (u16), seq (u16), count, flags, time0 (u32),
+ *     used (u16), dropped (u16, records lost before this block)
+ *   records, one per control tick:
+ *     mask: bit set for every field that differs from the previous record
+ *     per set bit a zigzag varint of the difference, in the order
+ *     dt (change of the tick period), localPa, remotePa, setpointPa, duty, mV
+ *   The first record of a block starts from time0 and zero values, so it
+ *   carries the absolute values. A steady tick with pressure noise takes 2..3 bytes.
+ * cFrecEncoder: start(pBlock, ...), add(sample) false when the block is full, finish()
+ * cFrecDecoder: start(pBlock) false for an invalid block, next(sample)
+ * cFrecStage: FREC_STAGE blocks in RAM between the control and the display core
+ *   add(sample): control core, never waits, drops the record without a free block
+ *   peek()/pop(): display core, the next full block
+ */
+#ifndef FRECORD_H
+#define FRECORD_H
+
+#include <atomic>
+
+#define FREC_BLOCK    256 // one flash page
+#define FREC_HEAD     16
+#define FREC_MAGIC    0xF7
+#define FREC_VERSION  1
+#define FREC_FIELDS   6
+#define FREC_REC_MAX  (1 + 5 * FREC_FIELDS) // mask and the longest varints
+#ifndef FREC_STAGE
+#define FREC_STAGE    4   // staged blocks, the firmware sets its own in setting.h
+#endif
+
+struct sFrecSample {
+    uint32_t time;     // us
+    int32_t localPa;   // absolute
+    int32_t remotePa;  // absolute, newest sample of the blow
+    int32_t setpointPa;
+    int32_t duty;      // positive: motor, negative: vent
+    int32_t mV;        // battery
+};
+
+struct sFrecHead {
+    uint16_t session;
+    uint16_t seq;
+    uint8_t count;
+    uint8_t flags;
+    uint32_t time0;
+    uint16_t used;
+    uint16_t dropped;
+};
+
+class cFrecEncoder {
+    uint8_t *pBlk;
+    int used;
+    int count;
+    uint32_t prevTime;
+    int32_t prevDt;
+    int32_t aPrev[FREC_FIELDS - 1];
+
+    static void put16(uint8_t *p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+    static void put32(uint8_t *p, uint32_t v) { put16(p, v); put16(p + 2, v >> 16); }
+
+    void putVar(int32_t v) {
+        uint32_t z = ((uint32_t) v << 1) ^ (uint32_t) (v >> 31); // zigzag
+        while (0x80 <= z) {
+            pBlk[used++] = (z & 0x7f) | 0x80;
+            z >>= 7;
+        }
+        pBlk[used++] = z;
+    }
+
+    public:
+    cFrecEncoder() : pBlk(nullptr), used(0), count(0) {}
+
+    void start(uint8_t *pBlock, uint16_t session, uint16_t seq, uint32_t time0, uint32_t dropped) {
+        pBlk = pBlock;
+        memset(pBlk, 0xff, FREC_BLOCK);
+        pBlk[0] = FREC_MAGIC;
+        pBlk[1] = FREC_VERSION;
+        put16(pBlk + 2, session);
+        put16(pBlk + 4, seq);
+        pBlk[7] = 0; // flags
+        put32(pBlk + 8, time0);
+        put16(pBlk + 14, dropped < 0xffff ? dropped : 0xffff);
+        used = FREC_HEAD;
+        count = 0;
+        prevTime = time0;
+        prevDt = 0;
+        memset(aPrev, 0, sizeof(aPrev));
+    }
+
+    bool add(const sFrecSample &s) {
+        if (FREC_BLOCK - used < FREC_REC_MAX || 255 <= count) {
+            return false;
+        }
+        int32_t dt = s.time - prevTime;
+        int32_t aVal[FREC_FIELDS - 1] = { s.localPa, s.remotePa, s.setpointPa, s.duty, s.mV };
+        int mask = dt != prevDt ? 1 : 0;
+        for (int idx = 0; idx < FREC_FIELDS - 1; idx++) {
+            mask |= aVal[idx] != aPrev[idx] ? 2 << idx : 0;
+        }
+        pBlk[used++] = mask;
+        if (mask & 1) {
+            putVar(dt - prevDt);
+        }
+        for (int idx = 0; idx < FREC_FIELDS - 1; idx++) {
+            if (mask & (2 << idx)) {
+                putVar(aVal[idx] - aPrev[idx]);
+                aPrev[idx] = aVal[idx];
+            }
+        }
+        prevTime = s.time;
+        prevDt = dt;
+        count++;
+        return true;
+    }
+
+    void finish() {
+        pBlk[6] = count;
+        put16(pBlk + 12, used);
+    }
+
+    int getUsed() const { return used; }
+};
+
+class cFrecDecoder {
+    const uint8_t *pBlk;
+    int pos;
+    int left;
+    uint32_t prevTime;
+    int32_t prevDt;
+    int32_t aPrev[FREC_FIELDS - 1];
+
+    static uint16_t get16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+    bool getVar(int32_t &v) {
+        uint32_t z = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (head.used <= pos) {
+                return false;
+            }
+            uint8_t b = pBlk[pos++];
+            z |= (uint32_t) (b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                v = (int32_t) (z >> 1) ^ -(int32_t) (z & 1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    public:
+    sFrecHead head;
+
+    bool start(const uint8_t *pBlock) {
+        pBlk = pBlock;
+        if (pBlk[0] != FREC_MAGIC || pBlk[1] != FREC_VERSION) {
+            return false;
+        }
+        head.session = get16(pBlk + 2);
+        head.seq = get16(pBlk + 4);
+        head.count = pBlk[6];
+        head.flags = pBlk[7];
+        head.time0 = get16(pBlk + 8) | ((uint32_t) get16(pBlk + 10) << 16);
+        head.used = get16(pBlk + 12);
+        head.dropped = get16(pBlk + 14);
+        if (head.used < FREC_HEAD || FREC_BLOCK < head.used) {
+            return false;
+        }
+        pos = FREC_HEAD;
+        left = head.count;
+        prevTime = head.time0;
+        prevDt = 0;
+        memset(aPrev, 0, sizeof(aPrev));
+        return true;
+    }
+
+    bool next(sFrecSample &s) {
+        int32_t diff;
+
+        if (left <= 0 || head.used <= pos) {
+            return false;
+        }
+        int mask = pBlk[pos++];
+        if (mask & 1) {
+            if (!getVar(diff)) return false;
+            prevDt += diff;
+        }
+        for (int idx = 0; idx < FREC_FIELDS - 1; idx++) {
+            if (mask & (2 << idx)) {
+                if (!getVar(diff)) return false;
+                aPrev[idx] += diff;
+            }
+        }
+        prevTime += prevDt;
+        s.time = prevTime;
+        s.localPa = aPrev[0];
+        s.remotePa = aPrev[1];
+        s.setpointPa = aPrev[2];
+        s.duty = aPrev[3];
+        s.mV = aPrev[4];
+        left--;
+        return true;
+    }
+};
+
+class cFrecStage {
+    uint8_t aaBlock[FREC_STAGE][FREC_BLOCK];
+    std::atomic<unsigned> head;  // blocks completed by the control core
+    std::atomic<unsigned> tail;  // blocks written by the display core
+    cFrecEncoder enc;
+    bool open;
+    uint16_t session;
+    uint16_t seq;
+    uint32_t dropped;       // since the last block
+    uint32_t droppedTotal;
+    uint32_t records;
+    public:
+    cFrecStage() : head(0), tail(0), open(false), session(0), seq(0), dropped(0), droppedTotal(0), records(0) {}
+
+    void setSession(uint16_t s) { session = s; seq = 0; }
+
+    void add(const sFrecSample &s) {
+        unsigned h = head.load(std::memory_order_relaxed);
+        if (!open) {
+            if (FREC_STAGE <= h - tail.load(std::memory_order_acquire)) {
+                dropped++; // the file system fell behind
+                droppedTotal++;
+                return;
+            }
+            enc.start(aaBlock[h % FREC_STAGE], session, seq++, s.time, dropped);
+            dropped = 0;
+            open = true;
+        }
+        if (!enc.add(s)) {
+            enc.finish();
+            head.store(h + 1, std::memory_order_release);
+            open = false;
+            add(s); // first record of the next block
+            return;
+        }
+        records++;
+    }
+
+    const uint8_t *peek() {
+        unsigned t = tail.load(std::memory_order_relaxed);
+        return t == head.load(std::memory_order_acquire) ? nullptr : aaBlock[t % FREC_STAGE];
+    }
+
+    void pop() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    unsigned getStaged() const { return head.load(std::memory_order_relaxed) - tail.load(std::memory_order_relaxed); }
+    uint32_t getRecords() const { return records; }
+    uint32_t getDropped() const { return droppedTotal; }
+};
+
+#endif // FRECORD_H
@@ -0,0 +1,182 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Link statistic for the Blow <-> Pipe UDP traffic
+ * cHisto: log bucketed histogram in fixed memory, 4 buckets per power of 2
+ *   add(val), percentile(pct), getCount(), getMax(), reset()
+ * cLinkStats: round trip time histogram, loss and reorder counters
+ *   onSend(seq, now)/onEcho(seq, now): sender side, matches echoes to sent datagrams
+ *   onReceive(seq): receiver side, counts sequence gaps and late arrivals
+ *   addRtt(us): RTT reported by the other side
+ *   summary(s): p50/p99/max RTT and counters as sLinkSummary
+ * Only depends on stdint.h so it can be compiled into the host simulation.
+ */
+#ifndef LINKSTATS_H
+#define LINKSTATS_H
+
+#include <stdint.h>
+
+#define HISTO_SUB      4  // buckets per power of 2
+#define HISTO_BUCKETS 80  // up to 2^20 (about 1 s in us)
+#define LINK_WINDOW   64  // datagrams in flight tracked by the sender, power of 2
+
+class cHisto {
+    uint32_t aBucket[HISTO_BUCKETS];
+    uint32_t count;
+    uint32_t maxVal;
+
+    static int bucket(uint32_t val) {
+        if (val < HISTO_SUB) {
+            return val;
+        }
+        int oct = 31 - __builtin_clz(val);
+        int idx = HISTO_SUB * (oct - 1) + ((val >> (oct - 2)) & (HISTO_SUB - 1));
+        return idx < HISTO_BUCKETS ? idx : HISTO_BUCKETS - 1;
+    }
+
+    // middle of the bucket
+    static uint32_t value(int idx) {
+        if (idx < HISTO_SUB) {
+            return idx;
+        }
+        int oct = idx / HISTO_SUB + 1;
+        uint32_t low = (uint32_t) (HISTO_SUB + idx % HISTO_SUB) << (oct - 2);
+        return low + ((1u << (oct - 2)) >> 1);
+    }
+
+    public:
+    cHisto() { reset(); }
+
+    void reset() {
+        for (int idx = 0; idx < HISTO_BUCKETS; idx++) {
+            aBucket[idx] = 0;
+        }
+        count = 0;
+        maxVal = 0;
+    }
+
+    void add(uint32_t val) {
+        aBucket[bucket(val)]++;
+        count++;
+        maxVal = val > maxVal ? val : maxVal;
+    }
+
+    uint32_t percentile(int pct) const {
+        if (count == 0) {
+            return 0;
+        }
+        uint32_t target = (uint32_t) (((uint64_t) count * pct + 99) / 100);
+        uint32_t sum = 0;
+        for (int idx = 0; idx < HISTO_BUCKETS; idx++) {
+            sum += aBucket[idx];
+            if (target <= sum) {
+                uint32_t val = value(idx);
+                return val < maxVal ? val : maxVal;
+            }
+        }
+        return maxVal;
+    }
+
+    uint32_t getCount() const { return count; }
+    uint32_t getMax() const { return maxVal; }
+};
+
+struct sLinkSummary {
+    uint32_t p50;      // RTT in us
+    uint32_t p99;
+    uint32_t max;
+    uint32_t samples;  // RTT values in the histogram
+    uint32_t packets;  // sent (sender) or received (receiver)
+    uint32_t lost;
+    uint32_t reordered;
+};
+
+class cLinkStats {
+    cHisto rtt;
+    uint32_t aSentTime[LINK_WINDOW];
+    uint16_t aSentSeq[LINK_WINDOW];
+    bool aPending[LINK_WINDOW];
+    uint16_t highSeq;
+    bool haveHigh;
+    uint32_t packets;
+    uint32_t lost;
+    uint32_t reordered;
+    public:
+    cLinkStats() { reset(); }
+
+    void reset() {
+        rtt.reset();
+        for (int idx = 0; idx < LINK_WINDOW; idx++) {
+            aPending[idx] = false;
+        }
+        haveHigh = false;
+        highSeq = 0;
+        packets = 0;
+        lost = 0;
+        reordered = 0;
+    }
+
+    // sender side
+    void onSend(uint16_t seq, uint32_t now) {
+        int slot = seq & (LINK_WINDOW - 1);
+        if (aPending[slot]) {
+            lost++; // no echo for a whole window
+        }
+        aSentSeq[slot] = seq;
+        aSentTime[slot] = now;
+        aPending[slot] = true;
+        packets++;
+    }
+
+    // returns the round trip time in us, 0 for an unknown or duplicate echo
+    uint32_t onEcho(uint16_t seq, uint32_t now) {
+        int slot = seq & (LINK_WINDOW - 1);
+        if (!aPending[slot] || aSentSeq[slot] != seq) {
+            return 0;
+        }
+        aPending[slot] = false;
+        if (haveHigh && (int16_t) (seq - highSeq) < 0) {
+            reordered++;
+        } else {
+            highSeq = seq;
+            haveHigh = true;
+        }
+        uint32_t val = now - aSentTime[slot];
+        rtt.add(val);
+        return val ? val : 1;
+    }
+
+    // receiver side
+    void onReceive(uint16_t seq) {
+        int16_t diff = seq - highSeq;
+        packets++;
+        if (!haveHigh || LINK_WINDOW <= diff || diff <= -LINK_WINDOW) {
+            haveHigh = true; // first datagram or the sender restarted
+            highSeq = seq;
+        } else if (0 < diff) {
+            lost += diff - 1;
+            highSeq = seq;
+        } else if (diff < 0) {
+            reordered++; // counted as lost when the gap was seen
+            lost -= lost ? 1 : 0;
+        }
+    }
+
+    void addRtt(uint32_t val) { rtt.add(val); }
+
+    void summary(sLinkSummary &s) const {
+        s.p50 = rtt.percentile(50);
+        s.p99 = rtt.percentile(99);
+        s.max = rtt.getMax();
+        s.samples = rtt.getCount();
+        s.packets = packets;
+        s.lost = lost;
+        s.reordered = reordered;
+    }
+};
+
+#endif // LINKSTATS_H
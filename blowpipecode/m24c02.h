@@ -10,6 +10,10 @@
  * readAll(): read the entrier (256 bytes) eeprom
  * get*(): return the cached bytes for the EEPROM
  * set*(): update the chached and EEPROM functions
+ *   writes are coalesced into 16 byte page writes, bytes that already hold
+ *   the value are not written, the write cycle end is found by ACK polling
+ * fill(addr, val, len): set a range to one value
+ * getPageWrites()/getBytesSkipped()/getPollMax(): write statistic
  */
 #include <Wire.h>
 #include <stdlib.h>
@@ -17,16 +21,33 @@
 
 #define M24C02_H
 
+// optional bus lock when the I2C bus is shared with another core
+#ifndef M24C02_LOCK
+#define M24C02_LOCK()
+#define M24C02_UNLOCK()
+#endif
+
+#define M24C02_PAGE     16    // bytes per page write
+#define M24C02_WRITE_US 10000 // give up polling after the worst case write time
+#define M24C02_POLL_US  200
+
 class cM24C02 {
     TwoWire &wire;
     uint8_t deviceAddress;
     unsigned char aData[256];
+    unsigned long pageWrites;
+    unsigned long bytesSkipped;
+    unsigned long pollMax;
     public:
     cM24C02(TwoWire &w, uint8_t da = 0x50) : wire(w), deviceAddress(da) {
+        pageWrites = 0;
+        bytesSkipped = 0;
+        pollMax = 0;
     }
 
     void readAll() {
         // read the entire EEPROM into aData array
+        M24C02_LOCK();
         for (int off = 0; off < sizeof(aData); ) {
             wire.beginTransmission(deviceAddress);
             wire.write((uint8_t)off); // start at address 0x00
@@ -35,6 +56,7 @@ class cM24C02 {
             wire.readBytes(aData + off, byteCount);
             off += byteCount;
         }
+        M24C02_UNLOCK();
     }
     ~cM24C02() {}
     int getByte(int addr) {
@@ -70,91 +92,100 @@ class cM24C02 {
         if (addr < 0 || addr >= sizeof(aData)) {
             return; // out of bounds
         }
-        aData[addr] = val;
-        wire.beginTransmission(deviceAddress);
-        wire.write((uint8_t)addr);
-        delay(1);
-        wire.write(val);
-        delay(1);
-        wire.endTransmission();
-
-        delay(10); // EEPROM write delay
+        writeRange(addr, &val, 1);
     }
 
     void setShort(int addr, unsigned short val) {
-        if (addr < 0 || addr >= sizeof(aData)) {
+        if (addr < 0 || addr + 1 >= sizeof(aData)) {
             return; // out of bounds
         }
-        if (14 < (addr & 0xf)) { // does not fit into 16 bytes block
-            setByte(addr, val);
-            setByte(addr+1, val >> 8);
-            return; // address must be even for short
-        }
-        aData[addr] = val;
-        aData[addr + 1] = val >> 8;
-
-        wire.beginTransmission(deviceAddress);
-        wire.write((uint8_t)addr);
-        wire.write((uint8_t)aData[addr]);
-        wire.write((uint8_t)aData[addr + 1]);
-        wire.endTransmission();
-        delay(10); // EEPROM write delay
+        unsigned char aVal[2] = { (unsigned char) val, (unsigned char) (val >> 8) };
+        writeRange(addr, aVal, 2);
     }
     void setInt(int addr, unsigned int val) {
-        if (addr < 0 || addr >= sizeof(aData)) {
+        if (addr < 0 || addr + 3 >= sizeof(aData)) {
             return; // out of bounds
         }
-        
-        if (12 < (addr & 0xf)) { // does not fir into 16 bytes block
-            setByte(addr, val);
-            setByte(addr+1, val >> 8);  
-            setByte(addr+2, val >> 16);
-            setByte(addr+3, val >> 24);  
-            return;
-        }
-
-        // This does fit into 16 bytes block
-        aData[addr] = val;
-        aData[addr + 1] = val >> 8;
-        aData[addr + 2] = val >> 16;
-        aData[addr + 3] = val >> 24;
-
-        wire.beginTransmission(deviceAddress);
-        wire.write((uint8_t)addr);
-        wire.write((uint8_t)aData[addr]);
-        wire.write((uint8_t)aData[addr + 1]);
-        wire.write((uint8_t)aData[addr + 2]);
-        wire.write((uint8_t)aData[addr + 3]);
-        wire.endTransmission();
-        delay(10); // EEPROM write delay
+        unsigned char aVal[4] = { (unsigned char) val, (unsigned char) (val >> 8),
+                                  (unsigned char) (val >> 16), (unsigned char) (val >> 24) };
+        writeRange(addr, aVal, 4);
     }
     void setBuffer(int addr, const unsigned char* buf, int len) {
         if (addr < 0 || addr + len > sizeof(aData)) {
             return; // out of bounds
         }
-
-        while (0 < len--) {
-            setByte(addr++, *buf++);
+        writeRange(addr, buf, len);
+    }
+    void fill(int addr, unsigned char val, int len) {
+        if (addr < 0 || addr + len > sizeof(aData)) {
+            return; // out of bounds
         }
-#if 0
-        memcpy(aData + addr, buf, len);
+        writeRange(addr, nullptr, len, val);
+    }
 
-        // For larger writes, do it in chunks of up to 16 bytes
-        while (len > 0) {
-            int chunkSize = 16 - (addr & 0xf);
-            chunkSize = (len < chunkSize) ? len : chunkSize;
-            wire.beginTransmission(deviceAddress);
-            wire.write((uint8_t)(addr));
-            for (int i = 0; i < chunkSize; i++) {
-                wire.write((uint8_t) aData[addr + i]);
+    unsigned long getPageWrites() const { return pageWrites; }
+    unsigned long getBytesSkipped() const { return bytesSkipped; }
+    unsigned long getPollMax() const { return pollMax; }
+
+    private:
+    // Page engine: the range is split at the 16 byte page boundaries, within a
+    // page only the span from the first to the last changed byte is written
+    // in one transaction, unchanged pages are skipped entirely.
+    // pSrc == nullptr writes val to every byte.
+    void writeRange(int addr, const unsigned char *pSrc, int len, unsigned char val = 0) {
+        while (0 < len) {
+            int chunk = M24C02_PAGE - (addr % M24C02_PAGE);
+            chunk = len < chunk ? len : chunk;
+            int first = -1;
+            int last = -1;
+            for (int idx = 0; idx < chunk; idx++) {
+                unsigned char b = pSrc ? pSrc[idx] : val;
+                if (aData[addr + idx] != b) {
+                    aData[addr + idx] = b;
+                    first = first < 0 ? idx : first;
+                    last = idx;
+                }
+            }
+            if (first < 0) {
+                bytesSkipped += chunk;
+            } else {
+                bytesSkipped += chunk - (last - first + 1);
+                writePage(addr + first, last - first + 1);
+            }
+            addr += chunk;
+            len -= chunk;
+            if (pSrc) {
+                pSrc += chunk;
             }
-            wire.endTransmission();
-            delay(10); // EEPROM write delay
-            len  -= chunkSize;
-            addr += chunkSize;
         }
-#endif
-        return;
+    }
+
+    void writePage(int addr, int len) {
+        M24C02_LOCK();
+        wire.beginTransmission(deviceAddress);
+        wire.write((uint8_t)addr);
+        wire.write((const uint8_t *) aData + addr, len);
+        wire.endTransmission();
+        M24C02_UNLOCK();
+        pageWrites++;
+        pollAck();
+    }
+
+    // the device does not ACK its address while the internal write cycle runs,
+    // the bus is released between the polls so the other core can use it
+    void pollAck() {
+        unsigned long start = micros();
+        unsigned long used;
+        int busy;
+        do {
+            delayMicroseconds(M24C02_POLL_US);
+            M24C02_LOCK();
+            wire.beginTransmission(deviceAddress);
+            busy = wire.endTransmission();
+            M24C02_UNLOCK();
+            used = micros() - start;
+        } while (busy != 0 && used < M24C02_WRITE_US);
+        pollMax = used > pollMax ? used : pollMax;
     }
 };
 
@@ -0,0 +1,207 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Non blocking access to the MS5607 pressure and temperature sensor
+ * cMS5607(TwoWire, osr, tempEvery): initialize the sensor function
+ * readProm(): read and check the calibration PROM (blocking, setup only)
+ * poll(now): advance the conversion state machine, never waits for the ADC
+ *   starts a conversion, returns and collects the result on a later call.
+ *   A temperature (D2) conversion is inserted after every tempEvery pressure
+ *   (D1) conversions. Returns true when a new pressure value is available.
+ * getPres(): last compensated pressure in Pa (0.01 mbar)
+ * getTemp(): last compensated temperature in 0.01 C
+ */
+#include <Wire.h>
+#ifndef MS5607_H
+
+#define MS5607_H
+
+#define MS5607_CMD_RESET 0x1E
+#define MS5607_CMD_ADC   0x00
+#define MS5607_CMD_D1    0x40
+#define MS5607_CMD_D2    0x50
+#define MS5607_CMD_PROM  0xA0
+
+// oversampling ratio, the value is added to the D1/D2 command
+#define MS5607_OSR_256  0x00
+#define MS5607_OSR_512  0x02
+#define MS5607_OSR_1024 0x04
+#define MS5607_OSR_2048 0x06
+#define MS5607_OSR_4096 0x08
+
+class cMS5607 {
+    TwoWire &wire;
+    uint8_t deviceAddress;
+    uint8_t osr;
+    uint8_t tempEvery;
+    uint8_t presCnt;
+    uint8_t state;
+    uint16_t aProm[8];
+    uint32_t d2;
+    int32_t dT;
+    int32_t temp;
+    int32_t pres;
+    unsigned long convStart;
+    uint32_t sampleCnt;
+
+    enum { IDLE, CONV_D1, CONV_D2 };
+
+    // max conversion time from the data sheet + 10%, in us
+    unsigned long convTime() const {
+        static const uint16_t aConvUs[5] = { 660, 1290, 2510, 5000, 9950 };
+        return aConvUs[osr >> 1];
+    }
+
+    bool command(uint8_t cmd) {
+        wire.beginTransmission(deviceAddress);
+        wire.write(cmd);
+        return wire.endTransmission() == 0;
+    }
+
+    uint32_t readAdc() {
+        if (!command(MS5607_CMD_ADC)) {
+            return 0;
+        }
+        if (wire.requestFrom(deviceAddress, (uint8_t) 3) != 3) {
+            return 0;
+        }
+        uint32_t val = wire.read();
+        val = (val << 8) | wire.read();
+        val = (val << 8) | wire.read();
+        return val; // 0 means the conversion was not finished
+    }
+
+    bool start(uint8_t cmd, unsigned long now) {
+        if (!command(cmd + osr)) {
+            state = IDLE;
+            return false;
+        }
+        state = cmd == MS5607_CMD_D1 ? CONV_D1 : CONV_D2;
+        convStart = now;
+        return true;
+    }
+
+    // first and second order compensation from the MS5607 data sheet
+    int32_t firstOrderTemp() const {
+        return 2000 + (int32_t) (((int64_t) dT * aProm[6]) >> 23);
+    }
+
+    void compensateTemp() {
+        dT = (int32_t) d2 - ((int32_t) aProm[5] << 8);
+        temp = firstOrderTemp();
+        if (temp < 2000) {
+            temp -= (int32_t) (((int64_t) dT * dT) >> 31);
+        }
+    }
+
+    void compensatePres(uint32_t d1) {
+        int64_t off  = ((int64_t) aProm[2] << 17) + (((int64_t) aProm[4] * dT) >> 6);
+        int64_t sens = ((int64_t) aProm[1] << 16) + (((int64_t) aProm[3] * dT) >> 7);
+        int32_t t = firstOrderTemp();
+
+        if (t < 2000) {
+            int64_t dt2 = (int64_t) (t - 2000) * (t - 2000);
+            off  -= (61 * dt2) >> 4;
+            sens -= 2 * dt2;
+            if (t < -1500) {
+                int64_t dt3 = (int64_t) (t + 1500) * (t + 1500);
+                off  -= 15 * dt3;
+                sens -= 8 * dt3;
+            }
+        }
+        pres = (int32_t) ((((d1 * sens) >> 21) - off) >> 15);
+    }
+
+    // CRC4 over the PROM, see AN520
+    bool checkProm() {
+        uint16_t aCopy[8];
+        uint16_t rem = 0;
+        memcpy(aCopy, aProm, sizeof(aCopy));
+        uint8_t crc = aCopy[7] & 0xf;
+        aCopy[7] &= 0xff00;
+        for (int cnt = 0; cnt < 16; cnt++) {
+            rem ^= (cnt & 1) ? (aCopy[cnt >> 1] & 0xff) : (aCopy[cnt >> 1] >> 8);
+            for (int bit = 8; bit > 0; bit--) {
+                rem = (rem & 0x8000) ? ((rem << 1) ^ 0x3000) : (rem << 1);
+            }
+        }
+        return ((rem >> 12) & 0xf) == crc;
+    }
+
+    public:
+    cMS5607(TwoWire &w, uint8_t o = MS5607_OSR_1024, uint8_t te = 16) : wire(w), deviceAddress(0x76), osr(o), tempEvery(te) {
+        presCnt = 0;
+        state = IDLE;
+        d2 = 0;
+        dT = 0;
+        temp = 2000;
+        pres = 0;
+        convStart = 0;
+        sampleCnt = 0;
+        memset(aProm, 0, sizeof(aProm));
+    }
+    ~cMS5607() {}
+
+    void setI2Caddr(uint8_t addr) { deviceAddress = addr; }
+
+    bool readProm() {
+        command(MS5607_CMD_RESET);
+        delay(3); // PROM reload after reset
+        for (int idx = 0; idx < 8; idx++) {
+            command(MS5607_CMD_PROM + 2*idx);
+            if (wire.requestFrom(deviceAddress, (uint8_t) 2) != 2) {
+                return false;
+            }
+            aProm[idx] = wire.read() << 8;
+            aProm[idx] |= wire.read();
+        }
+        state = IDLE;
+        return checkProm();
+    }
+
+    bool poll(unsigned long now) {
+        switch (state) {
+        case IDLE:
+            start(d2 ? MS5607_CMD_D1 : MS5607_CMD_D2, now);
+            return false;
+        case CONV_D2:
+            if (now - convStart < convTime()) {
+                return false;
+            }
+            if (uint32_t val = readAdc()) {
+                d2 = val;
+                compensateTemp();
+            }
+            start(MS5607_CMD_D1, now);
+            return false;
+        case CONV_D1:
+        default:
+            if (now - convStart < convTime()) {
+                return false;
+            }
+            uint32_t d1 = readAdc();
+            if (++presCnt >= tempEvery || d2 == 0) {
+                presCnt = 0;
+                start(MS5607_CMD_D2, now);
+            } else {
+                start(MS5607_CMD_D1, now);
+            }
+            if (d1 == 0) {
+                return false;
+            }
+            compensatePres(d1);
+            sampleCnt++;
+            return true;
+        }
+    }
+
+    int32_t getPres() const { return pres; }
+    int32_t getTemp() const { return temp; }
+    uint32_t getSampleCount() const { return sampleCnt; }
+};
+
+#endif // MS5607_H
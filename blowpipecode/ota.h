@@ -0,0 +1,252 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Streaming firmware update, the upload goes straight into the update
+ * partition, there is no intermediate file
+ * cSha256: SHA-256 on mbedtls (ESP32_S3) or BearSSL (RP2040W)
+ * cOtaStream:
+ *   begin(size, pSha256Hex): start an update, size of the image or 0 if not
+ *     known (UPDATE_SIZE_UNKNOWN), the expected digest is 64 hex characters
+ *   write(pData, len): add a chunk of the upload
+ *   end(): flush, compare the digest, only a matching image is activated
+ *   abort(pMsg): stop the update, the running firmware stays
+ *   getResult(pBuffer): outcome with size and throughput in KB/s
+ * ESP32_S3: two OTA_CHUNK buffers, a writer task on DISP_CORE erases/writes the
+ *   flash while the web server receives the next chunk into the other buffer
+ * RP2040W: the Updater stages the image in LittleFS, written in the caller
+ */
+#ifndef OTA_H
+#define OTA_H
+
+#if ESP32_S3
+#include <mbedtls/sha256.h>
+#elif RP2040W
+#include <bearssl/bearssl_hash.h>
+#endif
+
+#define OTA_CHUNK       4096
+#define OTA_DIGEST_SIZE 32
+
+class cSha256 {
+#if ESP32_S3
+    mbedtls_sha256_context ctx;
+    public:
+    void begin() { mbedtls_sha256_init(&ctx); mbedtls_sha256_starts(&ctx, 0); }
+    void update(const uint8_t *pData, size_t len) { mbedtls_sha256_update(&ctx, pData, len); }
+    void finish(uint8_t *pDigest) { mbedtls_sha256_finish(&ctx, pDigest); mbedtls_sha256_free(&ctx); }
+#elif RP2040W
+    br_sha256_context ctx;
+    public:
+    void begin() { br_sha256_init(&ctx); }
+    void update(const uint8_t *pData, size_t len) { br_sha256_update(&ctx, pData, len); }
+    void finish(uint8_t *pDigest) { br_sha256_out(&ctx, pDigest); }
+#endif
+};
+
+class cOtaStream {
+    cSha256 sha;
+    uint8_t aExpect[OTA_DIGEST_SIZE];
+    bool haveExpect;
+    bool active;
+    bool failed;
+    bool done;
+    uint32_t bytes;
+    unsigned long startMs;
+    unsigned long usedMs;
+    char aMsg[48];
+#if ESP32_S3
+    uint8_t aaBuf[2][OTA_CHUNK];
+    int aLen[2];
+    int fill;                 // buffer filled by the web server
+    QueueHandle_t fullQueue;  // buffer index to write
+    QueueHandle_t freeQueue;  // buffer index written
+    volatile bool writeError;
+
+    static void writerTask(void *pArg) {
+        cOtaStream *pOta = (cOtaStream *) pArg;
+        int idx;
+        while (true) {
+            if (xQueueReceive(pOta->fullQueue, &idx, portMAX_DELAY)) {
+                int len = pOta->aLen[idx];
+                if (len && !pOta->writeError && Update.write(pOta->aaBuf[idx], len) != (size_t) len) {
+                    pOta->writeError = true;
+                }
+                xQueueSend(pOta->freeQueue, &idx, portMAX_DELAY);
+            }
+        }
+    }
+
+    // hand the filled buffer to the writer, continue with the other one
+    void flushBuffer() {
+        xQueueSend(fullQueue, &fill, portMAX_DELAY);
+        xQueueReceive(freeQueue, &fill, portMAX_DELAY); // waits while both are busy
+        aLen[fill] = 0;
+    }
+
+    // wait until the writer returned the second buffer as well, afterwards
+    // fill is ours and the other buffer waits in freeQueue, whatever index
+    // fill ends up with
+    void drainWriter() {
+        int other;
+        xQueueSend(fullQueue, &fill, portMAX_DELAY);
+        xQueueReceive(freeQueue, &fill, portMAX_DELAY);
+        xQueueReceive(freeQueue, &other, portMAX_DELAY);
+        xQueueSend(freeQueue, &other, portMAX_DELAY);
+        aLen[fill] = 0;
+    }
+#endif
+
+    static int hexVal(char c) {
+        if ('0' <= c && c <= '9') return c - '0';
+        if ('a' <= c && c <= 'f') return c - 'a' + 10;
+        if ('A' <= c && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    public:
+    cOtaStream() : haveExpect(false), active(false), failed(false), done(false), bytes(0), startMs(0), usedMs(0) {
+        strcpy(aMsg, "no update");
+#if ESP32_S3
+        fullQueue = nullptr;
+        freeQueue = nullptr;
+#endif
+    }
+
+    bool begin(size_t size, const char *pSha256Hex) {
+        if (active) {
+#if ESP32_S3
+            drainWriter(); // the writer may still flash a buffer of the old upload
+#endif
+            Update.abort();
+            active = false;
+        }
+        haveExpect = pSha256Hex && strlen(pSha256Hex) == 2 * OTA_DIGEST_SIZE;
+        for (int idx = 0; haveExpect && idx < OTA_DIGEST_SIZE; idx++) {
+            int hi = hexVal(pSha256Hex[2*idx]);
+            int lo = hexVal(pSha256Hex[2*idx + 1]);
+            haveExpect = 0 <= hi && 0 <= lo;
+            aExpect[idx] = (hi << 4) | lo;
+        }
+        failed = false;
+        done = false;
+        bytes = 0;
+        usedMs = 0;
+        startMs = millis();
+        if (OTA_REQUIRE_SHA256 && !haveExpect) {
+            abort("sha256 missing");
+            return false;
+        }
+#if RP2040W
+        LittleFS.begin(); // the Updater stages the image as a file
+#endif
+        if (!Update.begin(size ? size : UPDATE_SIZE_UNKNOWN)) {
+            abort("no space for the image");
+            return false;
+        }
+        sha.begin();
+#if ESP32_S3
+        if (fullQueue == nullptr) {
+            int idx = 1;
+            fullQueue = xQueueCreate(2, sizeof(int));
+            freeQueue = xQueueCreate(2, sizeof(int));
+            xQueueSend(freeQueue, &idx, portMAX_DELAY);
+            xTaskCreatePinnedToCore(writerTask, "otaWriter", 4096, this, 1, nullptr, DISP_CORE);
+            fill = 0;
+        }
+        aLen[fill] = 0; // a previous drainWriter() may have left fill at 1
+        writeError = false;
+#endif
+        active = true;
+        strcpy(aMsg, "receiving");
+        return true;
+    }
+
+    bool write(const uint8_t *pData, size_t len) {
+        if (!active) {
+            return false;
+        }
+        sha.update(pData, len); // overlaps with the flash write of the previous chunk
+        bytes += len;
+#if ESP32_S3
+        while (0 < len) {
+            size_t part = OTA_CHUNK - aLen[fill];
+            part = len < part ? len : part;
+            memcpy(aaBuf[fill] + aLen[fill], pData, part);
+            aLen[fill] += part;
+            pData += part;
+            len -= part;
+            if (aLen[fill] == OTA_CHUNK) {
+                flushBuffer();
+            }
+        }
+        if (writeError) {
+            abort(Update.errorString());
+            return false;
+        }
+#elif RP2040W
+        if (Update.write((uint8_t *) pData, len) != len) {
+            abort(Update.errorString());
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    bool end() {
+        uint8_t aDigest[OTA_DIGEST_SIZE];
+
+        if (!active) {
+            return false;
+        }
+#if ESP32_S3
+        drainWriter();
+        if (writeError) {
+            abort(Update.errorString());
+            return false;
+        }
+#endif
+        sha.finish(aDigest);
+        if (haveExpect && memcmp(aDigest, aExpect, OTA_DIGEST_SIZE) != 0) {
+            abort("sha256 mismatch");
+            return false;
+        }
+        if (!Update.end(true)) {
+            abort(Update.errorString());
+            return false;
+        }
+        active = false;
+        done = true;
+        usedMs = millis() - startMs;
+        strcpy(aMsg, haveExpect ? "sha256 verified" : "not verified");
+        return true;
+    }
+
+    void abort(const char *pMsg) {
+        if (active) {
+#if ESP32_S3
+            drainWriter();
+#endif
+            Update.abort();
+        }
+        active = false;
+        failed = true;
+        usedMs = millis() - startMs;
+        strncpy(aMsg, pMsg, sizeof(aMsg) - 1);
+        aMsg[sizeof(aMsg) - 1] = 0;
+    }
+
+    bool isActive() const { return active; }
+    bool isDone() const { return done && !failed; }
+    uint32_t getKBps() const { return usedMs ? bytes / usedMs : 0; } // bytes/ms ~ KB/s
+
+    void getResult(char *pBuffer) const {
+        sprintf(pBuffer, "%s %s, %lu bytes in %lu ms, %lu KB/s", done && !failed ? "OK" : "FAIL",
+                aMsg, (unsigned long) bytes, usedMs, (unsigned long) getKBps());
+    }
+};
+
+#endif // OTA_H
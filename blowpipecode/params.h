@@ -0,0 +1,317 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Control parameters of the pipe that can be changed at runtime
+ * sPipeParam: the values the control core takes from the table, all int32_t
+ *   so the table addresses them by offset
+ * aParamInfo: name, offset, range of every value, the defaults are the
+ *   compile time settings (setting.h, defaultCtrlParam, the filter params)
+ * cParamTable:
+ *   begin(load): defaults, with load the values saved in REC_PIPE_PARAM
+ *     (call after cfg.begin())
+ *   set(aIdx, aVal, cnt, defaults): web task or menu, the values on top of
+ *     the current set or with defaults on top of the compile time settings,
+ *     all values in range or nothing changes, returns -1 or the position of
+ *     the first bad one, the new set is published as a whole
+ *   set(pName, val)/get(pName): one value on the writer side
+ *   poll(param): control core, once per tick, true with a new set in param,
+ *     a tick works on either the old or the new set
+ *   save(): store the values that differ from the defaults in REC_PIPE_PARAM,
+ *     a u16 mask of the table entries, then the values of the set bits in
+ *     table order, one byte for entries up to 255, else two (LE), so a few
+ *     changed values are a few bytes and an append seldom compacts the bank,
+ *     a newer firmware keeps the defaults of added entries
+ *   getJson(str): {"name":value,...}
+ * setupParams(server): GET /params returns the table as JSON, POST /params
+ *   with the form fields name=value&... sets the values, save=1 stores them
+ *   as well, defaults=1 goes back to the compile time settings, a value that
+ *   is not a whole decimal number is refused like one out of range
+ * The writers (web task, menu) serialize on a cBusGuard, the control core
+ * reads the newest set through a cLatest.
+ */
+#ifndef PARAMS_H
+#define PARAMS_H
+
+#include <stddef.h>
+#include <errno.h>
+
+#define PIPE_GAIN_MAX  20
+
+// starting points, the Kalman values assume about 20 Pa sensor noise
+static const sFilterParam localFilterParam = {
+    /* mode */ PRESS_FILTER, /* cutoffHz */ 20, /* q */ 100, /* r */ 400, /* rateHz */ CTRL_RATE_HZ,
+    /* idleBand */ PRESS_IDLE_PA, /* idleMs */ 2000, /* baseShift */ 12, /* baseInit */ FILTER_BASE_INIT
+};
+static const sFilterParam remoteFilterParam = {
+    /* mode */ PRESS_FILTER, /* cutoffHz */ 10, /* q */ 100, /* r */ 400, /* rateHz */ BLOW_SAMPLE_HZ,
+    /* idleBand */ PRESS_IDLE_PA, /* idleMs */ 2000, /* baseShift */ 11, /* baseInit */ FILTER_BASE_INIT
+};
+
+struct sPipeParam {
+    int32_t gain;        // pipe pressure per blow pressure
+    int32_t leadMs;      // pump reaction until measured, 0: slope feedforward off
+    int32_t kp;          // sCtrlParam
+    int32_t ki;
+    int32_t kd;
+    int32_t kff;
+    int32_t deadband;    // Pa
+    int32_t minDuty;
+    int32_t localHz;     // cutoff of the local and the remote filter
+    int32_t remoteHz;
+    int32_t idleBand;    // Pa, both filters
+    int32_t idleMs;
+    int32_t localShift;  // baseline time constant 2^shift samples
+    int32_t remoteShift;
+    int32_t baseInit;    // samples of the startup baseline, both filters
+};
+
+struct sParamInfo {
+    const char *pName;
+    uint16_t offset;     // in sPipeParam
+    int32_t min;
+    int32_t max;
+};
+
+// never reorder, the saved record is in this order
+static constexpr sParamInfo aParamInfo[] = {
+    { "gain",        offsetof(sPipeParam, gain),        1, PIPE_GAIN_MAX },
+    { "lead",        offsetof(sPipeParam, leadMs),      0, 300 },
+    { "kp",          offsetof(sPipeParam, kp),          0, 1024 },
+    { "ki",          offsetof(sPipeParam, ki),          0, 1024 },
+    { "kd",          offsetof(sPipeParam, kd),          0, 1024 },
+    { "kff",         offsetof(sPipeParam, kff),         0, 256 },
+    { "deadband",    offsetof(sPipeParam, deadband),    0, 2000 },
+    { "minduty",     offsetof(sPipeParam, minDuty),     0, CTRL_DUTY_MAX },
+    { "localhz",     offsetof(sPipeParam, localHz),     1, 100 },
+    { "remotehz",    offsetof(sPipeParam, remoteHz),    1, 50 },
+    { "idleband",    offsetof(sPipeParam, idleBand),    10, 2000 },
+    { "idlems",      offsetof(sPipeParam, idleMs),      100, 30000 },
+    { "localshift",  offsetof(sPipeParam, localShift),  4, 15 },
+    { "remoteshift", offsetof(sPipeParam, remoteShift), 4, 15 },
+    { "baseinit",    offsetof(sPipeParam, baseInit),    1, FILTER_BASE_MAX },
+};
+#define PARAM_COUNT ((int) (sizeof(aParamInfo) / sizeof(aParamInfo[0])))
+
+// bytes of an entry in REC_PIPE_PARAM, all minimums are >= 0
+static constexpr int
+paramWidth(int idx)
+{
+    return aParamInfo[idx].max <= 0xff ? 1 : 2;
+}
+
+static constexpr int
+paramBytes(int idx = 0)
+{
+    return idx < PARAM_COUNT ? paramWidth(idx) + paramBytes(idx + 1) : 0;
+}
+
+static_assert(PARAM_COUNT <= 16, "REC_PIPE_PARAM mask is 16 bit");
+static_assert(2 + paramBytes() <= CFG_REC_MAX, "REC_PIPE_PARAM does not fit a record");
+
+class cParamTable {
+    cBusGuard guard;         // writers: web task, menu
+    sPipeParam cur;          // writer side
+    cLatest<sPipeParam> link;
+
+    static int32_t &at(sPipeParam &p, int idx) {
+        return *(int32_t *) ((uint8_t *) &p + aParamInfo[idx].offset);
+    }
+
+    static bool inRange(int idx, int32_t val) {
+        return aParamInfo[idx].min <= val && val <= aParamInfo[idx].max;
+    }
+
+    public:
+    static sPipeParam getDefaults() {
+        sPipeParam p = {
+            PIPE_REMOTE_GAIN, PIPE_LEAD_MS,
+            defaultCtrlParam.kp, defaultCtrlParam.ki, defaultCtrlParam.kd, defaultCtrlParam.kff,
+            defaultCtrlParam.deadband, defaultCtrlParam.minDuty,
+            localFilterParam.cutoffHz, remoteFilterParam.cutoffHz,
+            localFilterParam.idleBand, localFilterParam.idleMs,
+            localFilterParam.baseShift, remoteFilterParam.baseShift,
+            localFilterParam.baseInit
+        };
+        return p;
+    }
+
+    static int find(const char *pName) {
+        for (int idx = 0; idx < PARAM_COUNT; idx++) {
+            if (strcmp(aParamInfo[idx].pName, pName) == 0) {
+                return idx;
+            }
+        }
+        return -1;
+    }
+
+    cParamTable() : cur(getDefaults()) {}
+
+    void begin(bool load) {
+        uint8_t aBuf[CFG_REC_MAX];
+        int len = load ? cfg.get(REC_PIPE_PARAM, aBuf, sizeof(aBuf)) : -1;
+        uint16_t mask = 2 <= len ? aBuf[0] | (aBuf[1] << 8) : 0;
+        sPipeParam p = getDefaults();
+        int pos = 2;
+
+        for (int idx = 0; idx < 16; idx++) {
+            if (!(mask & (1 << idx))) {
+                continue;
+            }
+            if (PARAM_COUNT <= idx || len < pos + paramWidth(idx)) {
+                p = getDefaults(); // newer or broken record, all or nothing
+                break;
+            }
+            int32_t val = aBuf[pos] | (paramWidth(idx) == 2 ? aBuf[pos + 1] << 8 : 0);
+            pos += paramWidth(idx);
+            if (inRange(idx, val)) {
+                at(p, idx) = val;
+            }
+        }
+        guard.lock();
+        cur = p;
+        link.put(cur);
+        guard.unlock();
+    }
+
+    int set(const int *aIdx, const int32_t *aVal, int cnt, bool defaults = false) {
+        guard.lock();
+        for (int pos = 0; pos < cnt; pos++) {
+            if (aIdx[pos] < 0 || PARAM_COUNT <= aIdx[pos] || !inRange(aIdx[pos], aVal[pos])) {
+                guard.unlock();
+                return pos;
+            }
+        }
+        if (defaults) {
+            cur = getDefaults();
+        }
+        for (int pos = 0; pos < cnt; pos++) {
+            at(cur, aIdx[pos]) = aVal[pos];
+        }
+        link.put(cur);
+        guard.unlock();
+        return -1;
+    }
+
+    bool set(const char *pName, int32_t val) {
+        int idx = find(pName);
+        return set(&idx, &val, 1) < 0;
+    }
+
+    int32_t get(const char *pName) {
+        int idx = find(pName);
+        return idx < 0 ? 0 : at(cur, idx);
+    }
+
+    bool poll(sPipeParam &param) { return link.get(param); }
+
+    // the record only changes with a value, cfg.set() skips an unchanged one
+    bool save() {
+        uint8_t aBuf[CFG_REC_MAX];
+        sPipeParam def = getDefaults();
+        uint16_t mask = 0;
+        int len = 2;
+
+        guard.lock();
+        for (int idx = 0; idx < PARAM_COUNT; idx++) {
+            int32_t val = at(cur, idx);
+            if (val == at(def, idx)) {
+                continue;
+            }
+            mask |= 1 << idx;
+            aBuf[len++] = (uint8_t) val;
+            if (paramWidth(idx) == 2) {
+                aBuf[len++] = (uint8_t) (val >> 8);
+            }
+        }
+        guard.unlock();
+        aBuf[0] = (uint8_t) mask;
+        aBuf[1] = (uint8_t) (mask >> 8);
+        return cfg.set(REC_PIPE_PARAM, aBuf, len);
+    }
+
+    void getJson(String &str) {
+        char aItem[32];
+        guard.lock();
+        str = "{";
+        for (int idx = 0; idx < PARAM_COUNT; idx++) {
+            snprintf(aItem, sizeof(aItem), "%s\"%s\":%ld", idx ? "," : "", aParamInfo[idx].pName, (long) at(cur, idx));
+            str += aItem;
+        }
+        str += "}";
+        guard.unlock();
+    }
+};
+
+extern cParamTable pipeParams;
+
+// the whole string is a decimal number, toInt() would take "abc" as 0
+bool
+parseParam(const String &str, int32_t &val)
+{
+    const char *pStr = str.c_str();
+    char *pEnd;
+
+    errno = 0;
+    long num = strtol(pStr, &pEnd, 10);
+    if (pEnd == pStr || *pEnd || errno || num < INT32_MIN || INT32_MAX < num) {
+        return false;
+    }
+    val = (int32_t) num;
+    return true;
+}
+
+void
+sendParamError(AsyncWebServerRequest *pReq, int idx)
+{
+    const sParamInfo &info = aParamInfo[idx];
+    char aMsg[80];
+
+    snprintf(aMsg, sizeof(aMsg), "{\"error\":\"%s\",\"min\":%ld,\"max\":%ld}",
+             info.pName, (long) info.min, (long) info.max);
+    pReq->send(400, "application/json", aMsg);
+}
+
+void
+setupParams(AsyncWebServer &server)
+{
+    server.on("/params", HTTP_GET, [](AsyncWebServerRequest *pReq) {
+        String json;
+
+        pipeParams.getJson(json);
+        pReq->send(200, "application/json", json);
+    });
+    server.on("/params", HTTP_POST, [](AsyncWebServerRequest *pReq) {
+        int aIdx[PARAM_COUNT];
+        int32_t aVal[PARAM_COUNT];
+        int cnt = 0;
+        String json;
+
+        for (int idx = 0; idx < PARAM_COUNT; idx++) {
+            if (pReq->hasParam(aParamInfo[idx].pName, true)) {
+                if (!parseParam(pReq->getParam(aParamInfo[idx].pName, true)->value(), aVal[cnt])) {
+                    sendParamError(pReq, idx);
+                    return;
+                }
+                aIdx[cnt++] = idx;
+            }
+        }
+        // defaults and the values in one step, a bad value leaves the old set
+        int bad = pipeParams.set(aIdx, aVal, cnt, pReq->hasParam("defaults", true));
+        if (0 <= bad) {
+            sendParamError(pReq, aIdx[bad]);
+            return;
+        }
+        if (pReq->hasParam("save", true) && !pipeParams.save()) {
+            pReq->send(500, "application/json", "{\"error\":\"save\"}");
+            return;
+        }
+        pipeParams.getJson(json);
+        pReq->send(200, "application/json", json);
+    });
+}
+
+#endif // PARAMS_H
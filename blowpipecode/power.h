@@ -0,0 +1,92 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Idle mode for the battery
+ * cPowerMode:
+ *   update(quiet, now): control core, once per tick, quiet for POWER_IDLE_MS
+ *     enters the idle mode (control tick CTRL_IDLE_HZ), the first tick that
+ *     is not quiet returns to CTRL_RATE_HZ from the next tick on
+ *   apply(radio): display core, follows the mode with the display tick
+ *     (DISP_IDLE_HZ), the contrast and with radio the Wi-Fi power save
+ *   isIdle(): current mode, both cores
+ *   getStatus(pBuffer): time share of the modes and the wake-ups
+ * The roles decide what quiet means: the pipe with both baselines idle and
+ * the actuators off (or no blow at all), the blow with its own pressure.
+ * In idle mode the loops sleep between the ticks instead of spinning.
+ */
+#ifndef POWER_H
+#define POWER_H
+
+#include <atomic>
+
+class cPowerMode {
+    std::atomic<bool> idle;
+    bool applied;              // display core
+    unsigned long quietSince;  // ms
+    unsigned long last;        // ms
+    unsigned long aTimeMs[2];  // active, idle
+    uint32_t wakeups;
+
+    // SH1106 contrast command, the display library has no call for it, runs
+    // on the display core like refresh(), so it never splits a frame
+    static void setContrast(uint8_t level) {
+        TwoWire *pW = display.getI2C();
+        pW->beginTransmission(0x3c);
+        pW->write(0x00); // command stream
+        pW->write(0x81);
+        pW->write(level);
+        pW->endTransmission();
+    }
+
+    public:
+    cPowerMode() : idle(false), applied(false), quietSince(0), last(0), wakeups(0) {
+        aTimeMs[0] = aTimeMs[1] = 0;
+    }
+
+    void update(bool quiet, unsigned long now) {
+        bool cur = idle.load(std::memory_order_relaxed);
+        quietSince = quiet ? quietSince : now;
+        bool next = quiet && POWER_IDLE_MS <= now - quietSince;
+        aTimeMs[cur] += last ? now - last : 0;
+        last = now;
+        if (next != cur) {
+            ctrlTick.adjustRate(next ? CTRL_IDLE_HZ : CTRL_RATE_HZ);
+            wakeups += !next;
+            idle = next;
+        }
+    }
+
+    void apply(bool radio) {
+        bool cur = idle;
+        if (cur == applied) {
+            return;
+        }
+        applied = cur;
+        dispTick.adjustRate(cur ? DISP_IDLE_HZ : DISP_RATE_HZ);
+        setContrast(cur ? DISP_IDLE_CONTRAST : DISP_CONTRAST);
+        if (radio) {
+#if ESP32_S3
+            WiFi.setSleep(cur); // modem sleep, wakes for the DTIM beacons
+#elif RP2040W
+            if (cur) { WiFi.lowPowerMode(); } else { WiFi.noLowPowerMode(); }
+#endif
+        }
+    }
+
+    bool isIdle() const { return idle; }
+
+    void getStatus(char *pBuffer) {
+        unsigned long total = aTimeMs[0] + aTimeMs[1];
+        sprintf(pBuffer, "Power: %s, idle %lu%% of %lu s, %lu wake-ups",
+                idle ? "idle" : "active", total ? (unsigned long) (100ULL * aTimeMs[1] / total) : 0UL,
+                total / 1000, (unsigned long) wakeups);
+    }
+};
+
+extern cPowerMode power;
+
+#endif // POWER_H
@@ -0,0 +1,127 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Filtering stage for a pressure stream, integer only
+ * cPressFilter(param): low pass or scalar Kalman filter plus an adaptive baseline
+ * update(pa, nowMs): feed one absolute sample in Pa, returns the filtered
+ *   gauge pressure (filtered - baseline) in Pa
+ * isReady(): the startup baseline is acquired (first baseInit samples)
+ * isIdle(): nobody is blowing / pumping, the baseline follows the ambient pressure
+ * getBaseline()/getFiltered(): absolute values in Pa
+ * The baseline only moves while the filtered pressure stays within idleBand
+ * of it for idleMs, so a long blow is never learned as the new ambient.
+ * Only depends on stdint.h so it can be compiled into the host simulation.
+ */
+#ifndef PRESSFILTER_H
+#define PRESSFILTER_H
+
+#include <stdint.h>
+
+#define FILTER_LOWPASS  0
+#define FILTER_KALMAN   1
+#define FILTER_NONE     2
+#define FILTER_BASE_INIT 16 // default of baseInit
+#define FILTER_BASE_MAX  64 // baseInit limit, baseSum * 256 stays in int32_t
+
+struct sFilterParam {
+    int32_t mode;       // FILTER_LOWPASS, FILTER_KALMAN or FILTER_NONE
+    int32_t cutoffHz;   // low pass corner frequency
+    int32_t q;          // Kalman process noise per sample in Pa^2
+    int32_t r;          // Kalman measurement noise in Pa^2
+    int32_t rateHz;     // update() call rate
+    int32_t idleBand;   // Pa around the baseline that counts as idle
+    int32_t idleMs;     // idle time before the baseline follows
+    int32_t baseShift;  // baseline time constant 2^baseShift samples
+    int32_t baseInit;   // samples averaged for the startup baseline, 1..FILTER_BASE_MAX
+};
+
+class cPressFilter {
+    sFilterParam param;
+    int32_t alpha;      // Q16 low pass coefficient
+    int32_t est;        // Q8 Pa filtered
+    uint32_t var;       // Kalman estimate variance in Pa^2
+    int32_t base;       // Q8 Pa baseline
+    int32_t baseAcc;    // remainder of the baseline steps, keeps slow drift
+    int32_t baseSum;
+    int baseCount;
+    uint32_t idleSince;
+    bool idle;
+    bool first;
+    public:
+    cPressFilter(const sFilterParam &p) {
+        setParam(p);
+        reset();
+    }
+
+    void reset() {
+        est = 0;
+        var = param.r;
+        base = 0;
+        baseAcc = 0;
+        baseSum = 0;
+        baseCount = 0;
+        idle = false;
+        first = true;
+    }
+
+    void setParam(const sFilterParam &p) {
+        param = p;
+        // 1 - exp(-w/fs) ~ w / (fs + w), w = 2 pi fc
+        int32_t w = 6283 * param.cutoffHz;
+        int32_t fs = 1000 * (param.rateHz > 0 ? param.rateHz : 1);
+        alpha = (int32_t) (((int64_t) w << 16) / (fs + w));
+    }
+    const sFilterParam &getParam() const { return param; }
+
+    int32_t update(int32_t pa, uint32_t nowMs) {
+        int32_t x = pa * 256;
+
+        if (first) {
+            first = false;
+            est = x;
+        } else if (param.mode == FILTER_LOWPASS) {
+            est += (int32_t) (((int64_t) (x - est) * alpha) >> 16);
+        } else if (param.mode == FILTER_KALMAN) {
+            var += param.q;
+            int32_t gain = (int32_t) (((uint64_t) var << 16) / (var + param.r));
+            est += (int32_t) (((int64_t) (x - est) * gain) >> 16);
+            var = (uint32_t) (((uint64_t) var * (65536 - gain)) >> 16);
+        } else {
+            est = x;
+        }
+
+        if (!isReady()) {
+            // a smaller baseInit set during the average ends it with the next sample
+            baseSum += pa;
+            if (++baseCount >= param.baseInit) {
+                base = baseSum * 256 / baseCount;
+                idleSince = nowMs;
+            }
+            return 0;
+        }
+
+        int32_t dev = (est - base) / 256;
+        if (dev < -param.idleBand || param.idleBand < dev) {
+            idle = false;
+            idleSince = nowMs;
+        } else if ((int32_t) (nowMs - idleSince) >= param.idleMs) {
+            idle = true;
+            baseAcc += est - base;
+            int32_t step = baseAcc >> param.baseShift;
+            base += step;
+            baseAcc -= step << param.baseShift;
+        }
+        return dev;
+    }
+
+    bool isReady() const { return 0 < baseCount && param.baseInit <= baseCount; }
+    bool isIdle() const { return idle; }
+    int32_t getBaseline() const { return base / 256; }
+    int32_t getFiltered() const { return est / 256; }
+};
+
+#endif // PRESSFILTER_H
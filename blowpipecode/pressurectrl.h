@@ -0,0 +1,205 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Closed loop pressure controller for the blowpipe motor and vent
+ * cPressureCtrl(param): set up the controller with the given gains
+ * step(setpoint, measured, ahead): one fixed rate step, returns the duty -255..255
+ *   ahead (the slope feedforward) only adds to the proportional part, the
+ *   integrator keeps working on the error of the setpoint
+ *   positive duty drives the motor, negative duty drives the vent
+ * reset(): clear the integrator and the derivative history
+ * cSetpointLead: slope feedforward, the setpoint is moved ahead along its slope
+ *   add(setpoint, timeUs): every new setpoint value, on the clock of its sample
+ *   predict(setpoint, leadUs): setpoint plus the slope over leadUs, the lead
+ *     covers the link and the pump delay (cPumpDelay) so the motor/vent start before the
+ *     error builds up, limited to LEAD_MAX_PA, slopes below LEAD_DEAD_PAS are noise
+ *   getSlope(): Pa/s, reset(): forget the history
+ * cPumpDelay: reaction time of the pump, measured on the running pipe
+ *   add(duty, measured, nowUs): every control step, a motor start (duty from
+ *     <= 0 to > 0) starts a measurement, a rise of PUMP_DETECT_PA of the
+ *     measured pressure ends it, no rise within PUMP_DELAY_MAX_MS or a stop
+ *     of the motor drops it, the result is smoothed over the starts
+ *   getMs(fallback): smoothed delay, fallback until the first measurement
+ * All pressures are gauge pressures in Pa, gains are Q8 (1/256) fixed point.
+ * Only depends on stdint.h so it can be compiled into the host simulation.
+ */
+#ifndef PRESSURECTRL_H
+#define PRESSURECTRL_H
+
+#include <stdint.h>
+
+#ifndef CTRL_RATE_HZ
+#define CTRL_RATE_HZ  100
+#endif
+#define CTRL_DUTY_MAX 255
+#define LEAD_ALPHA    160   // Q8 smoothing of the slope per sample
+#define LEAD_DEAD_PAS 2000  // Pa/s of the setpoint
+#define LEAD_MAX_PA   1000
+#define PUMP_DETECT_PA    200 // rise that counts as the reaction of the pump
+#define PUMP_DELAY_MAX_MS 500
+
+struct sCtrlParam {
+    int32_t kp;       // Q8 duty per Pa error
+    int32_t ki;       // Q8 duty per Pa error and second
+    int32_t kd;       // Q8 duty per Pa/s change of the measured pressure
+    int32_t kff;      // Q8 duty per Pa setpoint, covers the leak of the pipe
+    int32_t deadband; // Pa, error below is ignored
+    int32_t minDuty;  // smallest duty the DRV8837 + motor/vent react to
+    int32_t rateHz;   // step() call rate
+};
+
+// default tuning, verified with sim/plantsim
+static const sCtrlParam defaultCtrlParam = {
+    /* kp */ 32, /* ki */ 8, /* kd */ 0, /* kff */ 6,
+    /* deadband */ 50, /* minDuty */ 60, /* rateHz */ CTRL_RATE_HZ
+};
+
+class cPressureCtrl {
+    sCtrlParam param;
+    int32_t integ;      // Q8 duty
+    int32_t lastMeasured;
+    int32_t lastDuty;
+    bool first;
+    public:
+    uint32_t switchCount; // number of motor/vent/off transitions
+
+    cPressureCtrl(const sCtrlParam &p = defaultCtrlParam) : param(p) {
+        switchCount = 0;
+        reset();
+    }
+
+    void reset() {
+        integ = 0;
+        lastMeasured = 0;
+        lastDuty = 0;
+        first = true;
+    }
+
+    void setParam(const sCtrlParam &p) { param = p; }
+    const sCtrlParam &getParam() const { return param; }
+    int32_t getDuty() const { return lastDuty; }
+
+    int32_t step(int32_t setpoint, int32_t measured, int32_t ahead = 0) {
+        int32_t err = setpoint - measured;
+        int32_t rate = param.rateHz > 0 ? param.rateHz : CTRL_RATE_HZ;
+
+        if (-param.deadband < err && err < param.deadband) {
+            err = 0;
+        }
+        // a predicted error must not wind up the integrator
+        int32_t errLead = err + ahead;
+
+        // derivative on the measurement avoids a kick on setpoint steps
+        int32_t dMeas = first ? 0 : (measured - lastMeasured) * rate;
+        lastMeasured = measured;
+        first = false;
+
+        int32_t ff = setpoint > 0 ? param.kff * setpoint : 0;
+        int32_t pd = param.kp * errLead - param.kd * dMeas;
+        int32_t u  = (ff + pd + integ) >> 8;
+
+        // anti windup: only integrate while the output is not pushing into
+        // the limit in the same direction, and clamp the integrator itself
+        bool satHigh = CTRL_DUTY_MAX <= u;
+        bool satLow  = u <= -CTRL_DUTY_MAX;
+        if ((!satHigh || err < 0) && (!satLow || 0 < err)) {
+            integ += (param.ki * err) / rate;
+            const int32_t limit = CTRL_DUTY_MAX << 8;
+            integ = integ > limit ? limit : (integ < -limit ? -limit : integ);
+            u = (ff + pd + integ) >> 8;
+        }
+
+        u = u > CTRL_DUTY_MAX ? CTRL_DUTY_MAX : (u < -CTRL_DUTY_MAX ? -CTRL_DUTY_MAX : u);
+        if (-param.minDuty < u && u < param.minDuty) {
+            u = 0; // the motor would only hum, keep it off
+        }
+
+        int32_t oldDir = lastDuty > 0 ? 1 : (lastDuty < 0 ? -1 : 0);
+        int32_t newDir = u > 0 ? 1 : (u < 0 ? -1 : 0);
+        if (oldDir != newDir) {
+            switchCount++;
+        }
+        lastDuty = u;
+        return u;
+    }
+};
+
+class cSetpointLead {
+    int32_t last;
+    uint32_t lastUs;
+    int32_t slope;      // Pa/s
+    bool first;
+    public:
+    cSetpointLead() { reset(); }
+
+    void reset() {
+        last = 0;
+        lastUs = 0;
+        slope = 0;
+        first = true;
+    }
+
+    void add(int32_t setpoint, uint32_t timeUs) {
+        int32_t dt = (int32_t) (timeUs - lastUs);
+        if (!first && 0 < dt) {
+            int32_t d = (int32_t) ((int64_t) (setpoint - last) * 1000000 / dt);
+            slope += (int32_t) (((int64_t) (d - slope) * LEAD_ALPHA) >> 8);
+        }
+        first = false;
+        last = setpoint;
+        lastUs = timeUs;
+    }
+
+    int32_t predict(int32_t setpoint, uint32_t leadUs) const {
+        if (-LEAD_DEAD_PAS < slope && slope < LEAD_DEAD_PAS) {
+            return setpoint;
+        }
+        int32_t ahead = (int32_t) ((int64_t) slope * leadUs / 1000000);
+        ahead = ahead > LEAD_MAX_PA ? LEAD_MAX_PA : (ahead < -LEAD_MAX_PA ? -LEAD_MAX_PA : ahead);
+        return setpoint + ahead;
+    }
+
+    int32_t getSlope() const { return slope; }
+};
+
+class cPumpDelay {
+    int32_t lastDuty;
+    int32_t startPa;
+    uint32_t startUs;
+    bool waiting;
+    int32_t delayMs;    // smoothed
+    uint32_t count;
+    public:
+    cPumpDelay() : lastDuty(0), startPa(0), startUs(0), waiting(false), delayMs(0), count(0) {}
+
+    void add(int32_t duty, int32_t measured, uint32_t nowUs) {
+        bool start = 0 < duty && lastDuty <= 0;
+        lastDuty = duty;
+        if (start) {
+            startPa = measured;
+            startUs = nowUs;
+            waiting = true;
+            return;
+        }
+        uint32_t dt = nowUs - startUs;
+        if (!waiting || duty <= 0 || 1000UL * PUMP_DELAY_MAX_MS < dt) {
+            waiting = false;
+            return;
+        }
+        if (startPa + PUMP_DETECT_PA <= measured) {
+            int32_t ms = (int32_t) (dt / 1000);
+            delayMs = count ? delayMs + (ms - delayMs) / 4 : ms;
+            count++;
+            waiting = false;
+        }
+    }
+
+    int32_t getMs(int32_t fallback) const { return count ? delayMs : fallback; }
+    uint32_t getCount() const { return count; }
+};
+
+#endif // PRESSURECTRL_H
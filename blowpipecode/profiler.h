@@ -0,0 +1,187 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Loop profiler on the CPU cycle counter
+ * PROF_START(id)/PROF_STOP(id): measure a region, PROF_SCOPE(id): the rest of the block
+ * PROF_TICK(core): start of a tick, applies a pending reset of the stages of the core
+ * cProfiler:
+ *   begin(): read the CPU clock, call in setup()
+ *   add(id, cycles): count, min, max, mean and a cHisto in us per stage
+ *   requestReset(): from any core, every core clears its own stages at its next tick
+ *   report(out): text table, load is the share of the core time since the reset
+ * setupStats(server): /stats shows the table, /stats?reset=1 resets it
+ * Every stage is written by one core only, /stats reads without a lock, a
+ * value read during an update may be off by one sample.
+ * PROFILE 0 compiles all macros to nothing, /stats only reports that.
+ */
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+
+enum {
+    // control core
+    PROF_CTRL_TICK, PROF_SENSOR, PROF_ADC, PROF_UDP_RX, PROF_CONTROL, PROF_UDP_TX, PROF_RECORD,
+    // display core
+    PROF_DISP_TICK, PROF_REFRESH, PROF_TOGGLE, PROF_TOUCH, PROF_TELEM, PROF_FLUSH,
+    PROF_STAGES
+};
+
+#if PROFILE
+
+#if ESP32_S3
+#define PROF_CYCLES()  ESP.getCycleCount()
+#define PROF_CPU_MHZ() ESP.getCpuFreqMHz()
+#elif RP2040W
+#define PROF_CYCLES()  rp2040.getCycleCount()
+#define PROF_CPU_MHZ() (rp2040.f_cpu() / 1000000)
+#endif
+
+struct sProfStage {
+    const char *pName;
+    uint8_t core;
+};
+
+static const sProfStage aProfStage[PROF_STAGES] = {
+    {"ctrl tick", CTRL_CORE}, {"sensor", CTRL_CORE}, {"adc", CTRL_CORE}, {"udp rx", CTRL_CORE},
+    {"control", CTRL_CORE}, {"udp tx", CTRL_CORE}, {"record", CTRL_CORE},
+    {"disp tick", DISP_CORE}, {"refresh", DISP_CORE}, {"toggle", DISP_CORE}, {"touch", DISP_CORE},
+    {"telemetry", DISP_CORE}, {"rec flush", DISP_CORE}
+};
+
+struct sProfStat {
+    uint32_t count;
+    uint32_t minCyc;
+    uint32_t maxCyc;
+    uint64_t sumCyc;
+    cHisto histo; // us
+
+    void reset() {
+        count = 0;
+        minCyc = 0xffffffff;
+        maxCyc = 0;
+        sumCyc = 0;
+        histo.reset();
+    }
+};
+
+class cProfiler {
+    sProfStat aStat[PROF_STAGES];
+    std::atomic<bool> aResetReq[2];
+    unsigned long aSince[2]; // us, start of the statistic per core
+    uint32_t mhz;
+
+    public:
+    cProfiler() : mhz(1) {
+        for (int id = 0; id < PROF_STAGES; id++) {
+            aStat[id].reset();
+        }
+        aResetReq[0] = aResetReq[1] = false;
+        aSince[0] = aSince[1] = 0;
+    }
+
+    void begin() {
+        mhz = PROF_CPU_MHZ();
+        mhz = mhz ? mhz : 1;
+        aSince[0] = aSince[1] = micros();
+    }
+
+    void add(int id, uint32_t cyc) {
+        sProfStat &stat = aStat[id];
+        stat.count++;
+        stat.minCyc = cyc < stat.minCyc ? cyc : stat.minCyc;
+        stat.maxCyc = cyc > stat.maxCyc ? cyc : stat.maxCyc;
+        stat.sumCyc += cyc;
+        stat.histo.add(cyc / mhz);
+    }
+
+    void tick(int core) {
+        if (aResetReq[core].exchange(false)) {
+            for (int id = 0; id < PROF_STAGES; id++) {
+                if (aProfStage[id].core == core) {
+                    aStat[id].reset();
+                }
+            }
+            aSince[core] = micros();
+        }
+    }
+
+    void requestReset() {
+        aResetReq[0] = true;
+        aResetReq[1] = true;
+    }
+
+    void report(String &out) {
+        char aLine[112];
+        unsigned long now = micros();
+
+        sprintf(aLine, "%-10s %4s %9s %8s %8s %8s %8s %8s %6s\n",
+                "stage", "core", "count", "min us", "mean us", "p50 us", "p99 us", "max us", "load%");
+        out += aLine;
+        for (int id = 0; id < PROF_STAGES; id++) {
+            const sProfStat &stat = aStat[id];
+            int core = aProfStage[id].core;
+            unsigned long span = now - aSince[core];
+            double sumUs = (double) stat.sumCyc / mhz;
+            sprintf(aLine, "%-10s %4d %9lu %8.1f %8.1f %8lu %8lu %8.1f %6.2f\n",
+                    aProfStage[id].pName, core, (unsigned long) stat.count,
+                    stat.count ? (double) stat.minCyc / mhz : 0.0, stat.count ? sumUs / stat.count : 0.0,
+                    (unsigned long) stat.histo.percentile(50), (unsigned long) stat.histo.percentile(99),
+                    (double) stat.maxCyc / mhz, span ? 100.0 * sumUs / span : 0.0);
+            out += aLine;
+        }
+        sprintf(aLine, "CPU %lu MHz, core %d since %lu ms, core %d since %lu ms\n", (unsigned long) mhz,
+                CTRL_CORE, (now - aSince[CTRL_CORE]) / 1000, DISP_CORE, (now - aSince[DISP_CORE]) / 1000);
+        out += aLine;
+    }
+};
+
+extern cProfiler profiler;
+
+// the rest of the block
+class cProfScope {
+    int id;
+    uint32_t start;
+    public:
+    cProfScope(int i) : id(i), start(PROF_CYCLES()) {}
+    ~cProfScope() { profiler.add(id, PROF_CYCLES() - start); }
+};
+
+#define PROF_START(id)  uint32_t profStart##id = PROF_CYCLES()
+#define PROF_STOP(id)   profiler.add(id, PROF_CYCLES() - profStart##id)
+#define PROF_SCOPE(id)  cProfScope profScope##id(id)
+#define PROF_TICK(core) profiler.tick(core)
+
+#else
+
+#define PROF_START(id)
+#define PROF_STOP(id)
+#define PROF_SCOPE(id)
+#define PROF_TICK(core)
+
+#endif // PROFILE
+
+void
+setupStats(AsyncWebServer &server)
+{
+    server.on("/stats", HTTP_GET, [](AsyncWebServerRequest *pReq) {
+#if PROFILE
+        String out;
+        if (pReq->hasParam("reset")) {
+            profiler.requestReset();
+            out = "reset requested\n";
+        } else {
+            profiler.report(out);
+        }
+        pReq->send(200, "text/plain", out);
+#else
+        pReq->send(200, "text/plain", "profiler not compiled in, set PROFILE 1 in setting.h\n");
+#endif
+    });
+}
+
+#endif // PROFILER_H
@@ -18,92 +18,442 @@ extern WiFiUDP Udp;
 #define SERVER_MBAR_R  apTxtIntItem[3]
 #define SERVER_MVOLT_L  apTxtIntItem[4]
 #define SERVER_MVOLT_R  apTxtIntItem[5]
+#define SERVER_MIN_L    apTxtIntItem[6]
+#define SERVER_MIN_R    apTxtIntItem[7]
 
-void
-handlePipe(int pressure, int temp, int adc)
-{
-  static int baselinePressure;
-  static int nominalLocal  = 0;
-  static int nominalRemote = 0;
-  static int enableMotor = 0;
-  static int packageCnt;
-  static unsigned long lastTime;
-  unsigned long thisTime = millis();
-  // check for data receive
-  int packetSize = Udp.parsePacket();
-  int mV = ADC2MV(adc);
+cPressureCtrl pipeCtrl;
+sPipeParam pipeParam = cParamTable::getDefaults(); // control core, the set in use
+int pipeDuty;                  // control core, last duty of driveActuators()
+cBattery blowBattery;          // control core, from the mV the blow reports
 
-  if (0 < packetSize) {
-    uint16_t aPackage[4];
-    int n = Udp.read((uint8_t *) aPackage, sizeof(aPackage));
+#define PIPE_MAX_DRAIN  16 // datagrams read per control tick at most
+#define PIPE_SEQ_WINDOW 64 // older sequence numbers are reordered/duplicate, beyond: sender restarted
 
-    packageCnt += n/2;
-    
-    for (int idx = 0; 2*idx < n; idx++) {
-      switch (aPackage[idx] & 0xf000) {
-      case VAL_TIME:
-        UDPdata.time = aPackage[idx] & 0x0fff;
-        break;
-      case VAL_MVOLT:
-        UDPdata.mvolt = ADC2MV(aPackage[idx] & 0x0fff);
-        pCurDispItems->SERVER_MVOLT_R->setValue(UDPdata.mvolt);
-        break;
-      case VAL_MBAR:
-        UDPdata.mbar = aPackage[idx] & 0x0fff;
-        if (enableMotor < 16) {
-          enableMotor = enableMotor + 1;
-          baselinePressure += UDPdata.mbar;
-        } else if (enableMotor == 16) {
-          enableMotor = enableMotor + 1;
-          baselinePressure /= 16;
-          nominalRemote = baselinePressure + 5*(UDPdata.mbar - baselinePressure);
-        } else {
-          nominalRemote = baselinePressure + 5*(UDPdata.mbar - baselinePressure);
-        }
-        static char aMsg[16];
-        sprintf(aMsg, "%d/%d", UDPdata.mbar, baselinePressure);
-        pCurDispItems->pError->setValue(aMsg);
-        pCurDispItems->SERVER_MBAR_R->setValue(nominalRemote /*UDPdata.mbar*/);
-        break;
-      case VAL_TEMP:
-        UDPdata.temp = aPackage[idx] & 0x0fff;
-        break;
-      }
-    }
-    pCurDispItems->SERVER_UDPSIZE->setValue(n);
-  } else {
-    if ((lastTime + 500) <  thisTime) {
-      pCurDispItems->SERVER_UDPSIZE->setValue(-1);
-    }
-  }
+struct sUdpStats {
+  uint32_t datagrams;  // received
+  uint32_t dropped;    // older or duplicate sequence number
+  uint32_t superseded; // datagrams queued behind a newer one, their setpoint never reached the controller
+  uint32_t stale;      // samples older than PIPE_MAX_AGE_US on arrival
+  uint32_t linkLost;   // fail safe after PIPE_LINK_MS without a fresh sample
+  uint16_t depth;      // datagrams waiting at the last tick
+  uint16_t depthMax;
+};
+
+// snapshot of the control core, handed to the display core once per tick
+struct sPipeState {
+  int pressure;      // local mbar
+  int nominalRemote; // target of the local pressure in mbar
+  int baseline;      // remote baseline mbar
+  int32_t setpoint;  // Pa above the local baseline
+  int32_t target;    // setpoint moved ahead by the slope feedforward
+  int32_t slope;     // Pa/s of the setpoint
+  int32_t measured;  // Pa above the local baseline, filtered
+  int32_t localBase; // Pa
+  int32_t remoteBase;
+  bool localIdle;
+  bool remoteIdle;
+  int mV;
+  int soc;           // %, -1: no pack
+  int minutes;       // runtime remaining
+  int remoteSoc;
+  int remoteMinutes;
+  int udpSize;
+  int packageCnt;
+  int duty;
+  bool linkUp;       // fresh remote samples within PIPE_LINK_MS
+  bool run;          // PIPE_MODE_RUN, set in the menu
+  int gain;          // sPipeParam in use
+  int leadMs;
+  int pumpMs;        // measured pump delay used for the lead
+  int ctrlHz;        // rate of the controller and the local filter
+  unsigned long rxTime;
+  struct sUDPData remote;
+  struct sUdpStats udp;
+  sLinkSummary link; // RTT reported by the blow, loss/reorder seen here
+  bool synced;       // blow clock offset known, cleared on link loss and a sender restart
+  int32_t offset;    // us, pipe - blow
+  uint16_t clockErr; // us
+  uint32_t latP50;   // sensor (blow) -> actuator (pipe) in us
+  uint32_t latP99;
+  uint32_t latMax;
+};
+cLatest<sPipeState> pipeStateLink; // consumer: display core, the web pages peek()
 
-  toggleDisplay(thisTime, mV, UDPdata.mvolt);
-  pCurDispItems->SERVER_UDPCNT->setValue(packageCnt);
-  pCurDispItems->SERVER_MBAR_L->setValue(pressure); 
-  pCurDispItems->SERVER_MVOLT_L->setValue(mV);
-  display.refresh(displayIdx);
-  
-  if (16 <= enableMotor && nominalRemote < (pressure - 10)) { // Vent On
-    pCurDispItems->pIconItem->setValue(aaIcon[2]);
+// duty from cPressureCtrl: positive runs the motor, negative opens the vent
+void
+driveActuators(int duty)
+{
+  pipeDuty = duty;
+  if (duty < 0) { // Vent On
     motor.run(0);
     motor.setAwake(false);
     vent.setAwake(true);
-    vent.run(-255);
-  } else if (16 <= enableMotor && (pressure+10) < nominalRemote) { // Motor On
-    pCurDispItems->pIconItem->setValue(aaIcon[1]);
+    vent.run(duty);
+  } else if (0 < duty) { // Motor On
     vent.run(0);
     vent.setAwake(false);
     motor.setAwake(true);
-    motor.run(255);
-  } else {
-    pCurDispItems->pIconItem->setValue(aaIcon[0]); // switch off both
+    motor.run(duty);
+  } else { // switch off both
     vent.run(0);
     vent.setAwake(false);
     motor.run(0);
     motor.setAwake(false);
   }
-  
-  lastTime = thisTime;
+}
+
+// filtered remote pressure above its baseline, scaled to the pipe setpoint
+struct sPipeRemote {
+  cPressFilter filter;
+  cSetpointLead lead;
+  int32_t setpoint; // Pa
+  int32_t lastPa;   // newest raw sample, for the flight recorder
+  int32_t gain;
+
+  sPipeRemote() : filter(remoteFilterParam), setpoint(0), lastPa(0), gain(PIPE_REMOTE_GAIN) {}
+
+  // timeUs: sample time, the slope does not see the batching of the datagrams
+  void addPa(int32_t pa, uint32_t timeUs) {
+    lastPa = pa;
+    setpoint = gain * filter.update(pa, millis());
+    lead.add(setpoint, timeUs);
+  }
+};
+
+// a new set from pipeParams, all values change between two ticks
+void
+applyPipeParam(const sPipeParam &p, cPressFilter &localFilter, sPipeRemote &remote)
+{
+  sCtrlParam ctrl = pipeCtrl.getParam();
+  ctrl.kp = p.kp;
+  ctrl.ki = p.ki;
+  ctrl.kd = p.kd;
+  ctrl.kff = p.kff;
+  ctrl.deadband = p.deadband;
+  ctrl.minDuty = p.minDuty;
+  pipeCtrl.setParam(ctrl);
+
+  sFilterParam filter = localFilter.getParam();
+  filter.cutoffHz = p.localHz;
+  filter.idleBand = p.idleBand;
+  filter.idleMs = p.idleMs;
+  filter.baseShift = p.localShift;
+  filter.baseInit = p.baseInit;
+  localFilter.setParam(filter);
+
+  filter = remote.filter.getParam();
+  filter.cutoffHz = p.remoteHz;
+  filter.idleBand = p.idleBand;
+  filter.idleMs = p.idleMs;
+  filter.baseShift = p.remoteShift;
+  filter.baseInit = p.baseInit;
+  remote.filter.setParam(filter);
+  remote.gain = p.gain;
+}
+
+// answer a v2 datagram so the blow can measure the round trip time
+void
+sendPipeEcho(const sUDPPacket &pkt, uint32_t rxTime)
+{
+  uint8_t aBuf[ECHO_SIZE];
+  sUDPEcho echo = { pkt.seq, pkt.count ? pkt.aSample[0].time : 0, rxTime, 0 };
+
+  echo.txTime = micros();
+  udpEncodeEcho(aBuf, echo);
+  Udp.beginPacket(Udp.remoteIP(), Udp.remotePort());
+  Udp.write(aBuf, ECHO_SIZE);
+  Udp.endPacket();
+}
+
+// legacy nibble tagged words
+int
+parsePipeV1(const uint16_t *pWord, int n, struct sUDPData &UDPdata, sPipeRemote &remote)
+{
+  int samples = 0;
+
+  for (int idx = 0; 2*idx < n; idx++) {
+    switch (pWord[idx] & 0xf000) {
+    case VAL_TIME:
+      UDPdata.time = pWord[idx] & 0x0fff;
+      break;
+    case VAL_MVOLT:
+      UDPdata.mvolt = ADC2MV(pWord[idx] & 0x0fff);
+      break;
+    case VAL_MBAR:
+      UDPdata.mbar = pWord[idx] & 0x0fff;
+      remote.addPa(100 * UDPdata.mbar, micros());
+      samples++;
+      break;
+    case VAL_TEMP:
+      UDPdata.temp = pWord[idx] & 0x0fff;
+      break;
+    }
+  }
+  return samples;
+}
+
+// batched samples, all of them go through the baseline, the newest one is the setpoint
+// with the blow clock offset known, samples older than PIPE_MAX_AGE_US are skipped
+// and sampleTime gets the newest sample on the pipe clock
+int
+parsePipeV2(const sUDPPacket &pkt, struct sUDPData &UDPdata, sPipeRemote &remote,
+            uint32_t now, uint32_t &sampleTime, uint32_t &stale)
+{
+  int used = 0;
+
+  UDPdata.seq = pkt.seq;
+  if (pkt.hasStatus) {
+    UDPdata.mvolt = pkt.mvolt;
+    UDPdata.temp = pkt.temp;
+  }
+  for (int idx = 0; idx < pkt.count; idx++) {
+    if (pkt.hasClock) {
+      uint32_t pipeTime = pkt.aSample[idx].time + pkt.offset;
+      if (PIPE_MAX_AGE_US < (int32_t) (now - pipeTime)) {
+        stale++;
+        continue;
+      }
+      sampleTime = pipeTime;
+    }
+    used++;
+    UDPdata.mbar = pkt.aSample[idx].pa / 100;
+    UDPdata.time = ((pkt.aSample[idx].time / 1000) >> 8) & 0x0fff; // same unit as v1
+    remote.addPa(pkt.aSample[idx].pa, pkt.aSample[idx].time);
+  }
+  return used;
+}
+
+// the idle mode changed the control tick, the integrator, the derivative and
+// the local low pass follow it (the remote filter runs on the blow's samples)
+void
+applyCtrlRate(int32_t rateHz, cPressFilter &localFilter)
+{
+  sCtrlParam ctrl = pipeCtrl.getParam();
+  ctrl.rateHz = rateHz;
+  pipeCtrl.setParam(ctrl);
+
+  sFilterParam filter = localFilter.getParam();
+  filter.rateHz = rateHz;
+  localFilter.setParam(filter);
+}
+
+// control tick: receive, control, actuate - no display access
+void
+handlePipe(const sLocalState &local)
+{
+  static struct sUDPData UDPdata;
+  static sPipeState pipeState;
+  static sPipeRemote remote;
+  static cPressFilter localFilter(localFilterParam);
+  static cPumpDelay pumpDelay;
+  static sUdpStats udpStats;
+  static cLinkStats linkStats;
+  static cHisto latency;
+  static uint32_t sampleTime;
+  static unsigned long freshTime;
+  static int packageCnt;
+  static bool haveSeq;
+  static uint16_t lastSeq;
+  unsigned long thisTime = millis();
+  int depth = 0;
+  int fresh = 0;
+  int freshDatagrams = 0;
+  bool newSample = false;
+  int packetSize;
+
+  if (pipeParams.poll(pipeParam)) {
+    applyPipeParam(pipeParam, localFilter, remote);
+  }
+  if ((int32_t) ctrlTick.getRate() != pipeCtrl.getParam().rateHz) {
+    applyCtrlRate(ctrlTick.getRate(), localFilter);
+  }
+
+  // drain everything that is queued, the controller only needs the newest sample
+  PROF_START(PROF_UDP_RX);
+  while (depth < PIPE_MAX_DRAIN && 0 < (packetSize = Udp.parsePacket())) {
+    uint16_t aPackage[V2_MAX_SIZE / 2];
+    int n = Udp.read((uint8_t *) aPackage, sizeof(aPackage));
+    sUDPPacket pkt;
+
+    depth++;
+    if (udpDecodeV2((const uint8_t *) aPackage, n, pkt)) {
+      sendPipeEcho(pkt, micros());
+      linkStats.onReceive(pkt.seq);
+      if (pkt.hasRtt) {
+        linkStats.addRtt(pkt.rtt);
+      }
+      int16_t diff = pkt.seq - lastSeq;
+      if (haveSeq && -PIPE_SEQ_WINDOW < diff && diff <= 0) {
+        udpStats.dropped++; // reordered or duplicate
+        continue;
+      }
+      if (haveSeq && (diff <= -PIPE_SEQ_WINDOW || PIPE_SEQ_WINDOW <= diff)) {
+        pipeState.synced = false; // sender restarted, its clock is a new one
+      }
+      haveSeq = true;
+      lastSeq = pkt.seq;
+      int used = parsePipeV2(pkt, UDPdata, remote, micros(), sampleTime, udpStats.stale);
+      fresh += used;
+      freshDatagrams += 0 < used;
+      if (pkt.hasClock) {
+        newSample |= 0 < used;
+        pipeState.synced = true;
+        pipeState.offset = pkt.offset;
+        pipeState.clockErr = pkt.clockErr;
+      }
+    } else {
+      int used = parsePipeV1(aPackage, n < 8 ? n : 8, UDPdata, remote);
+      fresh += used;
+      freshDatagrams += 0 < used;
+    }
+    pipeState.udpSize = n;
+    pipeState.rxTime = thisTime;
+  }
+  packageCnt += fresh;
+  freshTime = fresh ? thisTime : freshTime;
+  // the samples of a batch all go through the filter, only a backlog of datagrams is superseded
+  udpStats.superseded += 1 < freshDatagrams ? freshDatagrams - 1 : 0;
+  udpStats.datagrams += depth;
+  udpStats.depth = depth;
+  udpStats.depthMax = depth > udpStats.depthMax ? depth : udpStats.depthMax;
+  PROF_STOP(PROF_UDP_RX);
+
+  PROF_START(PROF_CONTROL);
+  // 0 until the first conversion of the sensor, must not reach the startup baseline
+  int32_t measured = local.presPa ? localFilter.update(local.presPa, thisTime) : 0;
+  // fail safe: a lost blow must not keep the pipe on its last setpoint,
+  // motor and vent stay off until fresh samples arrive
+  bool linkUp = packageCnt && thisTime - freshTime < PIPE_LINK_MS;
+  if (pipeState.linkUp && !linkUp) {
+    udpStats.linkLost++;
+    pipeCtrl.reset();
+    remote.lead.reset();
+    pipeState.synced = false; // the blow may come back with a different clock
+  }
+  bool run = pipeMode.load(std::memory_order_relaxed) == PIPE_MODE_RUN;
+  if (pipeState.run && !run) {
+    pipeCtrl.reset(); // stopped in the menu, start without the old integrator
+  }
+  // slope feedforward: the setpoint ahead by the age of the newest sample and the
+  // measured pump delay (leadMs until the first measurement, 0: off), not while
+  // motor or vent already run at full duty in the direction of the slope, the
+  // lead can not speed them up and only adds overshoot
+  uint32_t age = pipeState.synced ? micros() - sampleTime : 0;
+  age = age < PIPE_MAX_AGE_US ? age : PIPE_MAX_AGE_US;
+  int32_t pumpMs = pumpDelay.getMs(pipeParam.leadMs);
+  bool saturated = 0 < remote.lead.getSlope() ? CTRL_DUTY_MAX <= pipeDuty : pipeDuty <= -CTRL_DUTY_MAX;
+  int32_t target = pipeParam.leadMs && !saturated ? remote.lead.predict(remote.setpoint, age + 1000UL * pumpMs) : remote.setpoint;
+  int duty = 0;
+  if (run && linkUp && remote.filter.isReady() && localFilter.isReady()) {
+    // both values relative to their own baseline, in Pa
+    duty = pipeCtrl.step(remote.setpoint, measured, target - remote.setpoint);
+  }
+  driveActuators(duty);
+  pumpDelay.add(duty, measured, micros());
+  PROF_STOP(PROF_CONTROL);
+  if (newSample) {
+    // the newest remote sample reached the motor/vent now
+    latency.add(micros() - sampleTime);
+  }
+  PROF_START(PROF_RECORD);
+  sFrecSample rec = { (uint32_t) micros(), local.presPa, remote.lastPa, remote.setpoint, duty, local.mV };
+  flightRec.add(rec);
+  PROF_STOP(PROF_RECORD);
+
+  pipeState.pressure = local.pressure;
+  pipeState.nominalRemote = (localFilter.getBaseline() + remote.setpoint) / 100;
+  pipeState.baseline = remote.filter.getBaseline() / 100;
+  pipeState.setpoint = remote.setpoint;
+  pipeState.target = target;
+  pipeState.slope = remote.lead.getSlope();
+  pipeState.measured = measured;
+  pipeState.localBase = localFilter.getBaseline();
+  pipeState.remoteBase = remote.filter.getBaseline();
+  pipeState.localIdle = localFilter.isIdle();
+  pipeState.remoteIdle = remote.filter.isIdle();
+  pipeState.mV = local.mV;
+  pipeState.soc = local.soc;
+  pipeState.minutes = local.minutes;
+  // the blow has no motor, its load is the board and the radio
+  blowBattery.add(UDPdata.mvolt, cBattery::loadMa(false, 0), micros());
+  pipeState.remoteSoc = blowBattery.getSoc();
+  pipeState.remoteMinutes = blowBattery.getMinutes();
+  pipeState.packageCnt = packageCnt;
+  pipeState.duty = duty;
+  pipeState.linkUp = linkUp;
+  pipeState.run = run;
+  pipeState.gain = pipeParam.gain;
+  pipeState.leadMs = pipeParam.leadMs;
+  pipeState.pumpMs = pumpMs;
+  pipeState.ctrlHz = localFilter.getParam().rateHz;
+  pipeState.remote = UDPdata;
+  pipeState.udp = udpStats;
+  if (depth) {
+    linkStats.summary(pipeState.link);
+  }
+  if (newSample) {
+    pipeState.latP50 = latency.percentile(50);
+    pipeState.latP99 = latency.percentile(99);
+    pipeState.latMax = latency.getMax();
+  }
+  pipeStateLink.put(pipeState);
+  power.update(!run || !linkUp || (remote.filter.isIdle() && localFilter.isIdle() && duty == 0), thisTime);
+}
+
+// display tick
+void
+displayPipe()
+{
+  static sPipeState pipeState;
+  static char aMsg[16];
+  unsigned long thisTime = millis();
+
+  pipeStateLink.get(pipeState); // keeps the last snapshot if nothing new
+  PROF_START(PROF_FLUSH);
+  // a flash write holds the control core as well, only in idle mode (a lost
+  // blow gets there after POWER_IDLE_MS) or stopped
+  flightRec.flush(power.isIdle() || !pipeState.run);
+  PROF_STOP(PROF_FLUSH);
+
+  if (!pipeState.run) {
+    strcpy(aMsg, "STOP");
+  } else if (pipeState.packageCnt && !pipeState.linkUp) {
+    strcpy(aMsg, "NO LINK");
+  } else if (pipeState.link.samples) {
+    getLinkShort(aMsg, pipeState.link);
+  } else {
+    sprintf(aMsg, "%d/%d", pipeState.remote.mbar, pipeState.baseline);
+  }
+  dispDirty.setStr(pCurDispItems->pError, aMsg);
+  dispDirty.setInt(pCurDispItems->SERVER_MBAR_R, pipeState.nominalRemote /*UDPdata.mbar*/);
+  dispDirty.setInt(pCurDispItems->SERVER_MVOLT_R, pipeState.remote.mvolt);
+  dispDirty.setInt(pCurDispItems->SERVER_UDPSIZE, (pipeState.rxTime + 500) < thisTime ? -1 : pipeState.udpSize);
+  dispDirty.setIcon(pCurDispItems->pIconItem, aaIcon[pipeState.duty < 0 ? 2 : (0 < pipeState.duty ? 1 : 0)]);
+
+  toggleDisplay(thisTime, pipeState.soc, pipeState.remoteSoc);
+  dispDirty.setInt(pCurDispItems->SERVER_UDPCNT, pipeState.packageCnt);
+  dispDirty.setInt(pCurDispItems->SERVER_MBAR_L, pipeState.pressure); 
+  dispDirty.setInt(pCurDispItems->SERVER_MVOLT_L, pipeState.mV);
+  dispDirty.setInt(pCurDispItems->SERVER_MIN_L, pipeState.minutes);
+  dispDirty.setInt(pCurDispItems->SERVER_MIN_R, pipeState.remoteMinutes);
+  PROF_START(PROF_REFRESH);
+  dispDirty.refresh(display, displayIdx, thisTime);
+  PROF_STOP(PROF_REFRESH);
+
+  if (telemetry.due(thisTime)) {
+    PROF_SCOPE(PROF_TELEM);
+    char aJson[TELEM_JSON_SIZE];
+    snprintf(aJson, sizeof(aJson),
+             "{\"local\":%d,\"target\":%d,\"remote\":%d,\"setpointPa\":%ld,\"measuredPa\":%ld,"
+             "\"duty\":%d,\"link\":%d,\"mV\":%d,\"remoteMV\":%d,\"soc\":%d,\"min\":%d,\"remoteSoc\":%d,\"remoteMin\":%d,"
+             "\"rttP50\":%lu,\"lateAvg\":%lu,\"lateMax\":%lu}",
+             pipeState.pressure, pipeState.nominalRemote, pipeState.remote.mbar,
+             (long) pipeState.setpoint, (long) pipeState.measured, pipeState.duty, pipeState.linkUp,
+             pipeState.mV, pipeState.remote.mvolt, pipeState.soc, pipeState.minutes,
+             pipeState.remoteSoc, pipeState.remoteMinutes, (unsigned long) pipeState.link.p50,
+             ctrlTick.getLateAvg(), ctrlTick.getLateMax());
+    telemetry.send(aJson);
+  }
 }
 
 cDisplayItem *
@@ -113,15 +463,18 @@ initPipe()
     cDisplayItem *pRet = genDefaultItems(pCurDispItems, "SERVER");
     cDisplayItem *pPrev = pRet;
 
-    pPrev = pCurDispItems->SERVER_UDPSIZE = new cTextIntItem(0, 3*8, "UDP: %d", pPrev);
-    pPrev = pCurDispItems->SERVER_UDPCNT  = new cTextIntItem(8*6, 3*8, "(%d)", pPrev);
-    pPrev = pCurDispItems->SERVER_MBAR_L  = new cTextIntItem(      0, 5*8, "mBa: %4d->", pPrev);
-    pPrev = pCurDispItems->SERVER_MBAR_R  = new cTextIntItem((7+4)*6, 5*8, "%4d", pPrev);
-    pPrev = pCurDispItems->SERVER_MVOLT_L = new cTextIntItem(      0, 6*8, "mV: %5d/", pPrev);
-    pPrev = pCurDispItems->SERVER_MVOLT_R = new cTextIntItem((5+5)*6, 6*8, "%5d", pPrev);
-    pPrev = pCurDispItems->pIconItem = new cIconItem(112, 5*8-1, 8, 11, pPrev);
+    pPrev = pCurDispItems->SERVER_UDPSIZE = dispDirty.track(new cTextIntItem(0, 3*8, "UDP: %d", pPrev));
+    pPrev = pCurDispItems->SERVER_UDPCNT  = dispDirty.track(new cTextIntItem(8*6, 3*8, "(%d)", pPrev));
+    pPrev = pCurDispItems->SERVER_MIN_L   = dispDirty.track(new cTextIntItem(      0, 4*8, "min: %4d/", pPrev));
+    pPrev = pCurDispItems->SERVER_MIN_R   = dispDirty.track(new cTextIntItem((5+5)*6, 4*8, "%4d", pPrev));
+    pPrev = pCurDispItems->SERVER_MBAR_L  = dispDirty.track(new cTextIntItem(      0, 5*8, "mBa: %4d->", pPrev));
+    pPrev = pCurDispItems->SERVER_MBAR_R  = dispDirty.track(new cTextIntItem((7+4)*6, 5*8, "%4d", pPrev));
+    pPrev = pCurDispItems->SERVER_MVOLT_L = dispDirty.track(new cTextIntItem(      0, 6*8, "mV: %5d/", pPrev));
+    pPrev = pCurDispItems->SERVER_MVOLT_R = dispDirty.track(new cTextIntItem((5+5)*6, 6*8, "%5d", pPrev));
+    pPrev = pCurDispItems->pIconItem = dispDirty.track(new cIconItem(112, 5*8-1, 8, 11, pPrev));
     pCurDispItems->SERVER_MBAR_R->setInverted(true);
     pCurDispItems->SERVER_MVOLT_R->setInverted(true);
+    pCurDispItems->SERVER_MIN_R->setInverted(true);
 
     return pRet;
 }
@@ -137,8 +490,7 @@ void setupPipe()
 
 void handleServerRootRequest (AsyncWebServerRequest *pReq)
 {
-    static char aBuffer[4096];
-    static char serverIndexHead[] = 
+    static const char serverIndexHead[] = 
     "<!DOCTYPE HTML>"
     "<html>"
     "<head>"
@@ -148,41 +500,71 @@ void handleServerRootRequest (AsyncWebServerRequest *pReq)
     "<body>"
       "<h1>Pipe Server</h1>"
     "<form method='POST' action='/update' enctype='multipart/form-data'>"
+        "<input type='text' name='sha256' size='64' placeholder='sha256 of the image'>"
         "<input type='file' name='update'>"
         "<input type='submit' value='Update'>"
     "</form>"
     "<form method='GET' action='/reset' enctype='multipart/form-data'>"
     "<input type='submit' value='Reset'>"
-      "<br>Compiled: " __DATE__ ", " __TIME__
-      "<br><hr>EEPROM: <p style=\"font-family:'Courier New'\">";
-    static char serverIndexTail[] = 
-    "</p></body>"
-    "</html>";
-
-    strcpy(aBuffer, serverIndexHead);
-    char *pPtr = aBuffer + strlen(serverIndexHead);
-    char aSmall[20] = ": 0123456789abcdef";
-    for (int idx = 0; idx < 256; idx++) {
-        if ((idx & 0xf) == 0) {
-            if (idx) {
-                strcpy(pPtr, aSmall);
-                pPtr += strlen(pPtr);
-            }
-            sprintf(pPtr, "<br>0x%02X: ", idx);
-            pPtr += strlen(pPtr);
-        }
-        int val = eeprom.getByte(idx);
-        aSmall[2+(idx & 0xf)] = val < 32  || val > 127? '.' : val;
-        sprintf(pPtr, " 0x%02X", val);
-        pPtr += strlen(pPtr);
-    }
-
-    strcpy(pPtr, aSmall);
-    pPtr += strlen(pPtr);
+      "<br>Compiled: " __DATE__ ", " __TIME__;
+    char aLine[256];
+    String status;
+    sPipeState pipeShown; // newest snapshot of the control core, the web task has its own copy
 
-    strcpy(pPtr, serverIndexTail);
+    pipeStateLink.peek(pipeShown);
+    status.reserve(1024);
+    status += "<br>";
+    getTickStatus(aLine);
+    status += aLine;
+    status += "<br>";
+    getDispStatus(aLine);
+    status += aLine;
+    sprintf(aLine, "<br>UDP: %lu datagrams, queue %u (max %u), dropped %lu, superseded %lu, link %s, lost %lu times",
+            (unsigned long) pipeShown.udp.datagrams, pipeShown.udp.depth, pipeShown.udp.depthMax,
+            (unsigned long) pipeShown.udp.dropped, (unsigned long) pipeShown.udp.superseded,
+            pipeShown.linkUp ? "up" : "down (motor/vent off)", (unsigned long) pipeShown.udp.linkLost);
+    status += aLine;
+    status += "<br>";
+    getLinkStatus(aLine, "Link", pipeShown.link);
+    status += aLine;
+    status += "<br>";
+    getTelemetryStatus(aLine);
+    status += aLine;
+    status += "<br>";
+    power.getStatus(aLine);
+    status += aLine;
+    status += "<br>";
+    battery.getStatus(aLine, "Battery");
+    status += aLine;
+    status += "<br>";
+    blowBattery.getStatus(aLine, "Blow battery");
+    status += aLine;
+    status += "<br>";
+    adcScan.getStatus(aLine);
+    status += aLine;
+    status += "<br>";
+    flightRec.getStatus(aLine);
+    status += aLine;
+    status += " <a href='/rec'>files</a>";
+    sprintf(aLine, "<br>Latency: blow sensor to actuator p50 %lu us, p99 %lu us, max %lu us, %lu stale",
+            (unsigned long) pipeShown.latP50, (unsigned long) pipeShown.latP99, (unsigned long) pipeShown.latMax,
+            (unsigned long) pipeShown.udp.stale);
+    status += aLine;
+    sprintf(aLine, "<br>Clock: %s, offset %ld us +-%u us",
+            pipeShown.synced ? "synced" : "not synced", (long) pipeShown.offset, pipeShown.clockErr);
+    status += aLine;
+    sprintf(aLine, "<br>Mode: %s, gain %d", pipeShown.run ? "run" : "stop", pipeShown.gain);
+    status += aLine;
+    status += " <a href='/params'>parameters</a>";
+    sprintf(aLine, "<br>Filter: setpoint %ld Pa, target %ld Pa (slope %ld Pa/s, lead %s, pump %d ms + link), measured %ld Pa, "
+            "local base %ld Pa (%s), remote base %ld Pa (%s)",
+            (long) pipeShown.setpoint, (long) pipeShown.target, (long) pipeShown.slope, pipeShown.leadMs ? "on" : "off", pipeShown.pumpMs, (long) pipeShown.measured,
+            (long) pipeShown.localBase, pipeShown.localIdle ? "tracking" : "held",
+            (long) pipeShown.remoteBase, pipeShown.remoteIdle ? "tracking" : "held");
+    status += aLine;
+    getEepromHead(status);
 
-    pReq->send_P(200, "text/html", aBuffer);
+    sendDumpPage(pReq, serverIndexHead, status);
 }
 
 void setupServerPipe(AsyncWebServer &server, const char *pHost, const char *pPassword, char *pIPaddress)
@@ -195,14 +577,17 @@ void setupServerPipe(AsyncWebServer &server, const char *pHost, const char *pPas
 
     MDNS.begin(pHost);
     server.on("/", HTTP_GET, [](AsyncWebServerRequest *pReq) { handleServerRootRequest(pReq);} );
+    setupLive(server, "Pipe live");
+    setupRecorder(server);
+    setupStats(server);
+    setupParams(server);
 
     server.on("/reset",
         HTTP_GET,
         [](AsyncWebServerRequest *pReq) { 
-            uint8_t aEmpty[1] = {0};
-            eeprom.setBuffer(EEPROM_DEV_NAME, aEmpty, 1);
-            eeprom.setBuffer(EEPROM_PASSWORD, aEmpty, 1);
-            eeprom.setBuffer(EEPROM_SSID_NAME, aEmpty, 1);
+            cfg.setStr(REC_DEV_NAME, "");
+            cfg.setStr(REC_PASSWORD, "");
+            cfg.setStr(REC_SSID_NAME, "");
             pReq->send(200, "text/plain", "OK, restarting...");
             delay(1000);
             DORESTART;
@@ -218,10 +603,9 @@ void setupServerPipe(AsyncWebServer &server, const char *pHost, const char *pPas
         "/reset",
         HTTP_GET, 
         [](AsyncWebServerRequest *pReq) {
-            uint8_t aEmpty[2] = {0xff, 0xff};
             pReq->send(200, "text/html", serverResetAndReboot);
             delay(100);
-            eeprom.setBuffer(EEPROM_DEV_NAME, aEmpty, 2);
+            cfg.setStr(REC_DEV_NAME, "");
             DORESTART;
         }
     );
@@ -20,17 +20,21 @@
 #define UNSET_TOUCH2 apTxtIntItem[4]
 
 extern WiFiUDP Udp;
-void handleUnset(int pressure, int temp, int adc)
+
+// display tick, nothing to control in this mode
+void handleUnset(const sLocalState &local)
 {
-  
-  int mV = ADC2MV(adc);
-  pCurDispItems->UNSET_MBAR->setValue(pressure); // mBar
-  pCurDispItems->UNSET_MVOLT->setValue(mV); // mV
-
-  pCurDispItems->UNSET_TOUCH1->setValue(touchRead(TOUCH1) / 1024);
-  pCurDispItems->UNSET_TOUCH2->setValue(touchRead(TOUCH2) / 1024);
-  pCurDispItems->UNSET_TOUCH0->setValue(touchRead(TOUCH0) / 1024);
-  display.refresh(displayIdx);
+  dispDirty.setInt(pCurDispItems->UNSET_MBAR, local.pressure); // mBar
+  dispDirty.setInt(pCurDispItems->UNSET_MVOLT, local.mV); // mV
+
+  // raw values for setting the thresholds, one pad per tick
+  static int pad;
+  cTextIntItem *apPad[3] = { pCurDispItems->UNSET_TOUCH0, pCurDispItems->UNSET_TOUCH1, pCurDispItems->UNSET_TOUCH2 };
+  dispDirty.setInt(apPad[pad], touchRead(aTouchSensor[pad].pin) / 1024);
+  pad = (pad + 1) % 3;
+  PROF_START(PROF_REFRESH);
+  dispDirty.refresh(display, displayIdx, millis());
+  PROF_STOP(PROF_REFRESH);
 }
 
 cDisplayItem *
@@ -40,12 +44,12 @@ initUndef()
     cDisplayItem *pRet = genDefaultItems(pCurDispItems, "BOOTING");
     cDisplayItem *pPrev = pRet;
 
-    pPrev = pCurDispItems->UNSET_MVOLT = new cTextIntItem(0, 3*8, "Bat: %1d.%03d V", 3, pPrev);
-    pPrev = pCurDispItems->UNSET_MBAR = new cTextIntItem(0, 4*8, "Pa: %6d Pa", pPrev);
+    pPrev = pCurDispItems->UNSET_MVOLT = dispDirty.track(new cTextIntItem(0, 3*8, "Bat: %1d.%03d V", 3, pPrev));
+    pPrev = pCurDispItems->UNSET_MBAR = dispDirty.track(new cTextIntItem(0, 4*8, "Pa: %6d Pa", pPrev));
     
-    pPrev = pCurDispItems->UNSET_TOUCH0 = new cTextIntItem( 0, 5*8, "T0: %3d", pPrev);
-    pPrev = pCurDispItems->UNSET_TOUCH1 = new cTextIntItem(64, 5*8, "T1: %3d", pPrev);
-    pPrev = pCurDispItems->UNSET_TOUCH2 = new cTextIntItem( 0, 6*8, "T2: %3d", pPrev);
+    pPrev = pCurDispItems->UNSET_TOUCH0 = dispDirty.track(new cTextIntItem( 0, 5*8, "T0: %3d", pPrev));
+    pPrev = pCurDispItems->UNSET_TOUCH1 = dispDirty.track(new cTextIntItem(64, 5*8, "T1: %3d", pPrev));
+    pPrev = pCurDispItems->UNSET_TOUCH2 = dispDirty.track(new cTextIntItem( 0, 6*8, "T2: %3d", pPrev));
     return pRet;
 }
 
@@ -62,8 +66,7 @@ void setupUnset()
 
 void handleUnsetRootRequest (AsyncWebServerRequest *pReq)
 {
-    static char aBuffer[4096];
-    static char serverIndexHead[] = 
+    static const char serverIndexHead[] = 
     "<!DOCTYPE HTML>"
     "<html>"
     "<head>"
@@ -73,6 +76,7 @@ void handleUnsetRootRequest (AsyncWebServerRequest *pReq)
     "<body>"
       "<h1>Blow/Pipe Server</h1>"
       "<form method='POST' action='/update' enctype='multipart/form-data'>"
+          "<input type='text' name='sha256' size='64' placeholder='sha256 of the image'>"
           "<input type='file' name='update'>"
           "<input type='submit' value='Update'>"
       "</form>"
@@ -94,36 +98,11 @@ void handleUnsetRootRequest (AsyncWebServerRequest *pReq)
         "<li>B or b : set as a blow client (requires DeviceName, SSID (corresponding pipe name), and Password)</li>"
         "<li>R, s, R, or S : reset device (clears DeviceName, SSID, and Password)</li>"
       "</ul>"
-      "<br>Compiled: " __DATE__ ", " __TIME__
-      "<br><hr>EEPROM: <p style=\"font-family:'Courier New'\">";
-    static char serverIndexTail[] = 
-    "</p></body>"
-    "</html>";
-
-    strcpy(aBuffer, serverIndexHead);
-    char *pPtr = aBuffer + strlen(serverIndexHead);
-    char aSmall[20] = ": 0123456789abcdef";
-    for (int idx = 0; idx < 256; idx++) {
-        if ((idx & 0xf) == 0) {
-            if (idx) {
-                strcpy(pPtr, aSmall);
-                pPtr += strlen(pPtr);
-            }
-            sprintf(pPtr, "<br>0x%02X: ", idx);
-            pPtr += strlen(pPtr);
-        }
-        int val = eeprom.getByte(idx);
-        aSmall[idx & 0xf] = val < 32  || val > 127? '.' : val;
-        sprintf(pPtr, " 0x%02X", val);
-        pPtr += strlen(pPtr);
-    }
+      "<br>Compiled: " __DATE__ ", " __TIME__;
+    String status;
 
-    strcpy(pPtr, aSmall);
-    pPtr += strlen(pPtr);
-
-    strcpy(pPtr, serverIndexTail);
-
-    pReq->send_P(200, "text/html", aBuffer);
+    getEepromHead(status);
+    sendDumpPage(pReq, serverIndexHead, status);
 }
 
 
@@ -142,18 +121,18 @@ handleUnsetApplyRequest (AsyncWebServerRequest *pReq, char *pS, char *pP, char *
     case 'b':
     case 'B':
         if (pS[0] && pP[0] && pD[0]) {
-            eeprom.setBuffer(EEPROM_DEV_NAME, (uint8_t *)pD, 16);
-            eeprom.setBuffer(EEPROM_PASSWORD, (uint8_t *)pP, 16);
-            eeprom.setBuffer(EEPROM_SSID_NAME, (uint8_t *)pS, 16);
+            cfg.setStr(REC_DEV_NAME, pD);
+            cfg.setStr(REC_PASSWORD, pP);
+            cfg.setStr(REC_SSID_NAME, pS);
             reboot = true;
             pCurDispItems->pDevTitle->updateText("Set Blow");
             display.refresh(DISP_UNDEF);
             delay(1000);
         } else {
             pD[0] = pP[0] = pS[0] = 0;
-            eeprom.setBuffer(EEPROM_DEV_NAME, (uint8_t *)pD, 1);
-            eeprom.setBuffer(EEPROM_PASSWORD, (uint8_t *)pP, 1);
-            eeprom.setBuffer(EEPROM_SSID_NAME, (uint8_t *)pS, 1);
+            cfg.setStr(REC_DEV_NAME, pD);
+            cfg.setStr(REC_PASSWORD, pP);
+            cfg.setStr(REC_SSID_NAME, pS);
             reboot = true;
             pCurDispItems->pDevTitle->updateText("Clear Blow");
             display.refresh(DISP_UNDEF);
@@ -163,16 +142,16 @@ handleUnsetApplyRequest (AsyncWebServerRequest *pReq, char *pS, char *pP, char *
     case 'p':
     case 'P':
         if (pD[0] && pP[0]) {
-            eeprom.setBuffer(EEPROM_DEV_NAME, (uint8_t *)pD, 16);
-            eeprom.setBuffer(EEPROM_PASSWORD, (uint8_t *)pP, 16);
+            cfg.setStr(REC_DEV_NAME, pD);
+            cfg.setStr(REC_PASSWORD, pP);
             pS[0] = 0;
-            eeprom.setBuffer(EEPROM_SSID_NAME, (uint8_t *)pS, 1);
+            cfg.setStr(REC_SSID_NAME, pS);
             reboot = true;
             delay(1000);
         } else {
-            eeprom.setBuffer(EEPROM_DEV_NAME, (uint8_t *)pD, 16);
-            eeprom.setBuffer(EEPROM_PASSWORD, (uint8_t *)pP, 16);
-            eeprom.setBuffer(EEPROM_SSID_NAME, (uint8_t *)pS, 16);
+            cfg.setStr(REC_DEV_NAME, pD);
+            cfg.setStr(REC_PASSWORD, pP);
+            cfg.setStr(REC_SSID_NAME, pS);
             reboot = true;
             pCurDispItems->pDevTitle->updateText("Clear Pipe");
             display.refresh(DISP_UNDEF);
@@ -184,9 +163,9 @@ handleUnsetApplyRequest (AsyncWebServerRequest *pReq, char *pS, char *pP, char *
     case 's':
     case 'S':
         pD[0] = pP[0] = pS[0] = 0;
-        eeprom.setBuffer(EEPROM_DEV_NAME, (uint8_t *)pD, 1);
-        eeprom.setBuffer(EEPROM_PASSWORD, (uint8_t *)pP, 1);
-        eeprom.setBuffer(EEPROM_SSID_NAME, (uint8_t *)pS, 1);
+        cfg.setStr(REC_DEV_NAME, pD);
+        cfg.setStr(REC_PASSWORD, pP);
+        cfg.setStr(REC_SSID_NAME, pS);
         reboot = true;
         break;
     }
@@ -205,9 +184,7 @@ handleUnsetApplyRequest (AsyncWebServerRequest *pReq, char *pS, char *pP, char *
 void
 handleUnsetResetRequest (AsyncWebServerRequest *pReq)
 {
-    for (int idx = 0; idx < 256; idx++) {
-        eeprom.setByte(idx, 0xff);
-    }
+    eeprom.fill(0, 0xff, 256);
     delay(1000);
     DORESTART;
 }
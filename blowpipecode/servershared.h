@@ -7,8 +7,16 @@
  * 
  * Shared functions: 
  * setupAP: Setting up the Access Point for the Undefined and Pipe mode
- * handleUploadRestart: Handle the restart after firmware update
- * handleUploadFile: Handle the file upload for firmware update
+ * handleUploadRestart: Report the update result, restart only after a verified update
+ * handleUploadFile: Stream the upload into the update partition (cOtaStream)
+ * getTickStatus: Rate and measured jitter of the control tick as text
+ * getDispStatus: Frames, skipped frames and the estimated I2C bytes of the display as text
+ * getLinkStatus: RTT percentiles, loss and reorder counters of the UDP link as text
+ * getLinkShort: RTT p50/p99 in ms for the status line of the display
+ * getTelemetryStatus: Clients, rate and dropped frames of the /live telemetry as text
+ * getEepromHead: EEPROM section header with the record store and write statistic
+ * sendDumpPage: chunked page of head, status text, EEPROM dump and tail, the
+ *   dump rows are rendered from the EEPROM cache while the response is sent
  */
 
 void
@@ -29,10 +37,20 @@ setupAP(const char *pSSID, const char *pPassword, char *pIPaddress)
 #endif 
 }
 
+cOtaStream ota;
+
 void
 handleUploadRestart(AsyncWebServerRequest *pReq) 
 {
-    pReq->send(200, "text/plain", (Update.hasError()) ? "FAIL" : "OK");
+    char aResult[96];
+
+    ota.getResult(aResult);
+    Serial.println(aResult);
+    if (!ota.isDone()) {
+        pReq->send(500, "text/plain", aResult); // keep running the current firmware
+        return;
+    }
+    pReq->send(200, "text/plain", aResult);
     delay(1000);
     DORESTART;
 }
@@ -40,30 +58,25 @@ handleUploadRestart(AsyncWebServerRequest *pReq)
 void
 handleUploadFile(AsyncWebServerRequest *pReq, String filename, size_t index, uint8_t *data, size_t len, bool final)
 {
-    static File uploadFile;
-
     if (index == 0) {
-        Serial.printf("Upload start: %s\n", filename.c_str());
-        // Open file for writing in LittleFS
-        uploadFile = LittleFS.open("/" + filename, "w");
-        if (!uploadFile) {
-            Serial.println("Failed to open file for writing");
-            return ;
+        String sha;
+        // form field in front of the file, or a header for curl uploads
+        if (pReq->hasParam("sha256", true)) {
+            sha = pReq->getParam("sha256", true)->value();
+        } else if (pReq->hasHeader("X-SHA256")) {
+            sha = pReq->getHeader("X-SHA256")->value();
         }
+        Serial.printf("Update start: %s\n", filename.c_str());
+        // contentLength() is the multipart body with the boundaries and the
+        // sha256 field, not the image, the Updater takes the size from end()
+        ota.begin(0, sha.c_str());
     }
-
-    // Write received chunk
-    if (uploadFile) {
-        uploadFile.write(data, len);
+    if (ota.isActive() && len) {
+        ota.write(data, len);
     }
-
-    if (final) {
-        Serial.printf("Upload complete: %s, size: %u bytes\n", filename.c_str(), (unsigned int)(index + len));
-        if (uploadFile) {
-            uploadFile.close();
-        }
+    if (final && ota.isActive()) {
+        ota.end();
     }
-    return;
 }
 
 void
@@ -82,3 +95,128 @@ getRequest(AsyncWebServerRequest *pReq, const char *pName, char *pBuffer)
         pBuffer[0] = 0;
     }
 }
+
+void
+getTickStatus(char *pBuffer)
+{
+    sprintf(pBuffer, "Tick: %lu Hz, late avg %lu us max %lu us, missed %lu",
+            ctrlTick.getRate(), ctrlTick.getLateAvg(), ctrlTick.getLateMax(), ctrlTick.getMissed());
+}
+
+void
+getDispStatus(char *pBuffer)
+{
+    sprintf(pBuffer, "Display: %u full frames, %u capped, %u frames/s",
+            (unsigned) dispDirty.getFrames(), (unsigned) dispDirty.getSkipped(),
+            (unsigned) dispDirty.getFramesPerSec());
+}
+
+void
+getLinkStatus(char *pBuffer, const char *pName, const sLinkSummary &link)
+{
+    sprintf(pBuffer, "%s: RTT p50 %lu us, p99 %lu us, max %lu us (%lu), %lu datagrams, %lu lost, %lu reordered",
+            pName, (unsigned long) link.p50, (unsigned long) link.p99, (unsigned long) link.max,
+            (unsigned long) link.samples, (unsigned long) link.packets,
+            (unsigned long) link.lost, (unsigned long) link.reordered);
+}
+
+void
+getLinkShort(char *pBuffer, const sLinkSummary &link)
+{
+    // "Stat: " leaves 15 characters, clamp to 999.9 ms
+    unsigned long p50 = link.p50 < 999999 ? link.p50 : 999999;
+    unsigned long p99 = link.p99 < 999999 ? link.p99 : 999999;
+    snprintf(pBuffer, 16, "%lu.%lu/%lu.%lums", p50 / 1000, p50 / 100 % 10, p99 / 1000, p99 / 100 % 10);
+}
+
+void
+getTelemetryStatus(char *pBuffer)
+{
+    sprintf(pBuffer, "<a href='/live'>Live</a>: %u clients, %u Hz, %lu frames, %lu dropped",
+            (unsigned) telemetry.getClients(), telemetry.getRate(),
+            (unsigned long) telemetry.getSent(), (unsigned long) telemetry.getDropped());
+}
+
+void
+getEepromHead(String &page)
+{
+    char aLine[224];
+
+    sprintf(aLine, "<br><hr>EEPROM: <p style=\"font-family:'Courier New'\">"
+            "record bank %d generation %u, %d bytes free<br>"
+            "%lu page writes, %lu bytes unchanged, write cycle max %lu us",
+            cfg.getBank(), cfg.getGeneration(), cfg.getFree(),
+            eeprom.getPageWrites(), eeprom.getBytesSkipped(), eeprom.getPollMax());
+    page += aLine;
+}
+
+#define DUMP_ROWS    16
+#define DUMP_ROW_LEN (10 + 16*5 + 2 + 16) // "<br>0xNN: ", 16 x " 0xNN", ": ", 16 characters
+
+// one row of the EEPROM dump, always DUMP_ROW_LEN characters
+void
+renderDumpRow(char *pOut, int row)
+{
+    static const char aHex[] = "0123456789ABCDEF";
+    char *pAscii = pOut + 10 + 16*5 + 2;
+
+    memcpy(pOut, "<br>0x", 6);
+    pOut[6] = aHex[row];
+    pOut[7] = '0';
+    pOut[8] = ':';
+    pOut[9] = ' ';
+    pOut += 10;
+    for (int idx = 0; idx < 16; idx++) {
+        int val = eeprom.getByte(16*row + idx);
+        pOut[0] = ' ';
+        pOut[1] = '0';
+        pOut[2] = 'x';
+        pOut[3] = aHex[val >> 4];
+        pOut[4] = aHex[val & 0xf];
+        pOut += 5;
+        // keep the row length fixed: no HTML escapes, replace the special characters
+        pAscii[idx] = val < 32 || val > 126 || val == '<' || val == '>' || val == '&' ? '.' : val;
+    }
+    pOut[0] = ':';
+    pOut[1] = ' ';
+}
+
+// copy the part of [pSrc, pSrc + len) that lies at the page offset index
+size_t
+copySegment(uint8_t *pBuf, size_t maxLen, size_t &index, const char *pSrc, size_t len)
+{
+    if (len <= index) {
+        index -= len;
+        return 0;
+    }
+    size_t n = len - index < maxLen ? len - index : maxLen;
+    memcpy(pBuf, pSrc + index, n);
+    index = 0;
+    return n;
+}
+
+// Nothing is shared between requests: the status text belongs to the
+// response, the rows are rendered from the EEPROM cache chunk by chunk.
+void
+sendDumpPage(AsyncWebServerRequest *pReq, const char *pHead, const String &status)
+{
+    static const char aTail[] = "</p></body></html>";
+
+    pReq->send(pReq->beginChunkedResponse("text/html",
+        [pHead, status](uint8_t *pBuf, size_t maxLen, size_t index) -> size_t {
+            size_t used = 0;
+            used += copySegment(pBuf + used, maxLen - used, index, pHead, strlen(pHead));
+            used += copySegment(pBuf + used, maxLen - used, index, status.c_str(), status.length());
+            for (int row = 0; row < DUMP_ROWS && used < maxLen; row++) {
+                if (DUMP_ROW_LEN <= index) {
+                    index -= DUMP_ROW_LEN;
+                    continue;
+                }
+                char aRow[DUMP_ROW_LEN];
+                renderDumpRow(aRow, row);
+                used += copySegment(pBuf + used, maxLen - used, index, aRow, DUMP_ROW_LEN);
+            }
+            used += copySegment(pBuf + used, maxLen - used, index, aTail, sizeof(aTail) - 1);
+            return used;
+        }));
+}
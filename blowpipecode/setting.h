@@ -25,14 +25,18 @@
   #error Select either RP2040W or ESP32_S3
 #endif
 
-#include <MS5xxx.h>
 #include <DRV8837.h>
 #include "Display.h"
+#include "dispdirty.h"
+#include "udpproto.h"
+#include "linkstats.h"
+#include "clocksync.h"
 
 #define PROM_I2C Wire
 #define PRESSURE_I2C Wire1
 #if RP2040W
 
+#include <Updater.h>
 #define DORESTART rp2040.restart()
 
 #define DISP_I2C false /* false == Wire, ture == Wire1 */
@@ -92,6 +96,8 @@ sTouchSensor aTouchSensor[] = {
 sMenueInfo aMainMenu[] = {
     {0x1000, "Main"},
     {0x2000, "Settings"},
+    {0x2100, "Gain"},
+    {0x2200, "Mode"},
     {0x3000, "Exit"},
     {0}
 };
@@ -108,6 +114,58 @@ sMenueInfo aMainMenu[] = {
 #define STATE_UNSET   (1 << 3)
 #define STATE_PIPE    (1 << 4)
 #define STATE_BLOW    (1 << 5)
+#define CTRL_RATE_HZ 200 /* control tick: sensor, UDP, motor/vent */
+#define DISP_RATE_HZ 20  /* display update, touch and housekeeping */
+#define DISP_MAX_FPS 10  /* cap for frames pushed to the SH1106 */
+
+#define UDP_PROTO      2    /* Blow -> Pipe format, 1: legacy 4 words every 250 ms */
+#define BLOW_SAMPLE_HZ 100  /* mouthpiece samples per second (50..200) */
+#define BLOW_BATCH     2    /* samples per datagram */
+#define BLOW_STATUS_MS 1000 /* battery and temperature interval */
+#define PIPE_MAX_AGE_US 50000 /* older remote samples do not reach the controller */
+#define PIPE_LINK_MS   400   /* no fresh remote sample for this long: motor and vent off */
+#define PIPE_LEAD_MS   80    /* pump reaction until the pipe measured it, added to the measured link delay for the slope feedforward, 0: off */
+#define PIPE_REMOTE_GAIN 5    /* pipe pressure per blow pressure, both above their baseline */
+#define PRESS_FILTER   FILTER_LOWPASS /* FILTER_LOWPASS, FILTER_KALMAN or FILTER_NONE */
+#define PRESS_IDLE_PA  100   /* Pa around the baseline that count as not blowing */
+#define OTA_REQUIRE_SHA256 1 /* refuse firmware updates without a sha256 digest */
+#define TELEM_RATE_HZ  10    /* /live telemetry frames per second, up to DISP_RATE_HZ */
+#define FREC_FILES     4     /* flight recorder files, rotated */
+#define FREC_FILE_KB   128   /* per file, a few minutes of control ticks */
+#define FREC_STAGE     128   /* RAM blocks of 256 bytes held while the pipe is active, about 30 s */
+#define FREC_FLUSH_MAX 16    /* blocks written per display tick while quiet, one flash sector */
+#define PROFILE        1     /* per stage cycle counts on /stats, 0 compiles them out */
+#define POWER_IDLE_MS  5000  /* nobody blowing this long: idle mode */
+#define CTRL_IDLE_HZ   20    /* control tick in idle mode */
+#define DISP_IDLE_HZ   4     /* display tick in idle mode */
+#define BLOW_IDLE_HZ   10    /* mouthpiece samples per second in idle mode, one per datagram */
+#define DISP_CONTRAST  0x80  /* SH1106 contrast, active */
+#define DISP_IDLE_CONTRAST 0x08 /* dimmed in idle mode */
+#define ADC_SCAN       1     /* ADC0..2 sampled continuously by DMA, 0: analogRead() in the control tick */
+#define ADC_SCAN_HZ    10000 /* conversions per second, all channels */
+#define ADC_SCAN_AVG   16    /* conversions per channel and frame */
+#define ADC_READ_AVG   4     /* analogRead() per tick without ADC_SCAN */
+#define BATT_TAU_MS    8000  /* filter of the battery voltage at rest */
+#define BATT_LOAD_TAU_MS 60000 /* mean load for the runtime remaining */
+#define BATT_RINT_MOHM 180   /* pack, wiring and switch, voltage sag per mA */
+#define BATT_MIN_MV    3300  /* below: no pack, USB powered */
+#define BATT_3S_MV     8700  /* first reading above: 3S (11.1 V) pack, else 2S (7.4 V) */
+#define BATT_MAH_2S    1000  /* capacity of the 2S pack */
+#define BATT_MAH_3S    2200  /* capacity of the 3S pack */
+#define BATT_ACTIVE_MA 180   /* board, sensor, OLED and Wi-Fi in active mode */
+#define BATT_IDLE_MA   90    /* the same in idle mode */
+#define BATT_MOTOR_MA  1400  /* pump at full duty */
+#define BATT_VENT_MA   300   /* vent solenoid at full duty */
+#define BATT_WARN_PCT  20    /* slow display blink below */
+#define BATT_ALARM_PCT 10    /* fast display blink below */
+
+// The control tick runs on CTRL_CORE, display, touch, web and Wi-Fi on DISP_CORE.
+// RP2040W: loop() on core 0 with the CYW43 Wi-Fi, loop1() on core 1.
+// ESP32_S3: loop() on core 1, display task on core 0 with the Wi-Fi stack,
+// build AsyncTCP with CONFIG_ASYNC_TCP_RUNNING_CORE=0 to keep it off core 1.
+#define CTRL_CORE 1
+#define DISP_CORE 0
+
 #define DISP_UNDEF 0
 #define DISP_SERVER 1  
 #define DISP_CLIENT 2
@@ -124,8 +182,19 @@ struct sUDPData {
   uint16_t mvolt;
   uint16_t mbar;
   uint16_t temp;
+  uint16_t seq;
 } ;
 
+// local sensor values, control core -> display core
+struct sLocalState {
+  int pressure; // mbar
+  int32_t presPa;
+  int temp;     // 0.1 C
+  int mV;
+  int soc;      // %, -1: no pack
+  int minutes;  // runtime remaining, -1: no pack
+};
+
 int sensorAddr;
 
 
@@ -133,9 +202,11 @@ struct sDispItem {
     cIconItem *pIconItem;
     cTextItem *pDevTitle;
     cTextStrItem *pDevIP, *pError;
-    cTextIntItem *apTxtIntItem[6];
+    cTextIntItem *apTxtIntItem[8];
 } aDispItems[3], *pCurDispItems = nullptr;
 
+cDispDirty dispDirty(DISP_MAX_FPS);
+
 
 cDisplayItem *genDefaultItems(struct sDispItem *pCDI, const char *pTitle)
 {
@@ -144,9 +215,9 @@ cDisplayItem *genDefaultItems(struct sDispItem *pCDI, const char *pTitle)
     cDisplayItem *pPrev = pRet;
 
     pPrev = new cTextItem(128 - 6*strlen(aVersion) - 3,   3, aVersion,   pPrev);
-    pPrev = pCDI->pDevTitle = new cTextItem(4,   3, pTitle,   pPrev);
-    pPrev = pCDI->pDevIP = new cTextStrItem(0, 2*8, "IP: %s",  pPrev);
-    pPrev = pCDI->pError = new cTextStrItem(0, 7*8, "Stat: %s", pPrev);
+    pPrev = pCDI->pDevTitle = dispDirty.track(new cTextItem(4,   3, pTitle,   pPrev));
+    pPrev = pCDI->pDevIP = dispDirty.track(new cTextStrItem(0, 2*8, "IP: %s",  pPrev));
+    pPrev = pCDI->pError = dispDirty.track(new cTextStrItem(0, 7*8, "Stat: %s", pPrev));
     
     pCurDispItems->pError->setValue("n/a");
 
@@ -155,7 +226,6 @@ cDisplayItem *genDefaultItems(struct sDispItem *pCDI, const char *pTitle)
 }
 
 extern cDisplay display;
-extern struct sUDPData UDPdata;
 
 extern char aDevName[17];
 extern char aSSID[17];
@@ -166,25 +236,24 @@ extern int displayIdx;
 extern IPAddress serverAddr;
 extern DRV8837 motor;
 extern DRV8837 vent;
-extern MS5xxx sensor;
+extern cMS5607 sensor;
 extern cM24C02 eeprom;
+extern cCfgStore cfg;
+extern cTick ctrlTick;
+extern cTick dispTick;
 
-extern void toggleDisplay(unsigned long thisTime, int mv1, int mv2);
+extern void toggleDisplay(unsigned long thisTime, int soc1, int soc2);
 extern void handleUploadRestart(AsyncWebServerRequest *pReq);
 extern void handleUploadFile(AsyncWebServerRequest *pReq, String filename, size_t index, uint8_t *data, size_t len, bool final);
 extern void setupAP(const char *pSSID, const char *pPassword, char *pIPaddress);
 extern void getRequest(AsyncWebServerRequest *pReq, const char *pName, char *pBuffer);
-// EEPROM offsets
-#define EEPROM_MAJOR 0
-#define EEPROM_MINOR 1
-#define EEPROM_PATCH 2
-#define EEPROM_DEV_NAME  16
-#define EEPROM_PASSWORD  (EEPROM_DEV_NAME + 16)
-#define EEPROM_SSID_NAME (EEPROM_PASSWORD + 16)
-
-#define VAL_TIME  0x4000
-#define VAL_MVOLT 0x5000
-#define VAL_MBAR  0x6000
-#define VAL_TEMP  0x7000
+extern void getTickStatus(char *pBuffer);
+extern void getDispStatus(char *pBuffer);
+extern void getLinkStatus(char *pBuffer, const char *pName, const sLinkSummary &link);
+extern void getLinkShort(char *pBuffer, const sLinkSummary &link);
+extern void getTelemetryStatus(char *pBuffer);
+extern void getEepromHead(String &page);
+extern void sendDumpPage(AsyncWebServerRequest *pReq, const char *pHead, const String &status);
+
 
 #endif
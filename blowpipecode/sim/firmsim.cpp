@@ -0,0 +1,577 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Run the unmodified firmware (blowpipecode.ino, ESP32_S3 path) as a pipe on
+ * the host against the mocks in sim/mock and the plant model:
+ * - control core: loop(), display core: displayStep() on the dispTick, each
+ *   one with its own virtual clock, the one behind runs next
+ * - Wire: SH1106 at 0x3C, Wire1: M24C02 at 0x50 (legacy layout "Pipe", the
+ *   firmware migrates it) and MS5607 at 0x76 reading the plant pressure,
+ *   transfers take their bus time on the clock of the calling core
+ * - the blow is emulated: BLOW_SAMPLE_HZ samples in v2 datagrams with a
+ *   one way delay of SIM_NET_US + jitter and SIM_LOSS_PCT loss, the echoes
+ *   of the pipe feed a cClockSync like on the real blow
+ * - motor/vent duty drive the plant in SIM_PLANT_US steps, the motor current
+ *   sags the battery reading by SIM_BATT_RINT, plus SIM_ADC_NOISE
+ * Only the I2C transfers, the flash writes, delay() and SIM_LOOP_US per loop()
+ * pass cost virtual time, the CPU time of the firmware is not modeled. A
+ * flash write of one core holds the other one (XIP/cache off on the chips).
+ * Every scenario runs without the slope feedforward first, the lead line
+ * compares the response lag at SIM_LAG_PA and the control quality.
+ * The /stats table at the end covers the profile, its times are the I2C and
+ * delay() time of every stage.
+ * Every scenario runs in its own process, the firmware statics start fresh.
+ * Touch steps of a scenario go through the touch interrupt on the display core.
+ * The parameter request of a scenario goes to /params like from the browser.
+ *
+ * Build and run: make -C blowpipecode/sim bench
+ * Usage: firmsim [scenario...]
+ */
+#include "Arduino.h"
+#include "../blowpipecode.ino"
+#include "simdev.h"
+#include "plant.h"
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define SIM_CTRL        0       // core of loop()
+#define SIM_DISP        1       // core of displayStep()
+#define SIM_IDLE_MS     2000    // before the profile, the baselines settle
+#define SIM_MS          6000    // length of the profile
+#define SIM_LOOP_US     20      // one loop() pass besides the I2C transfers, on average
+#define SIM_PLANT_US    100     // plant model step
+#define SIM_NET_US      1500    // one way Wi-Fi delay
+#define SIM_JITTER_US   1000
+#define SIM_LOSS_PCT    1
+#define SIM_BLOW_CLOCK  7340000 // blow micros() ahead of the pipe
+#define SIM_AMBIENT_PA  101325  // pipe
+#define SIM_BLOW_PA     100880  // blow, other sensor offset
+#define SIM_NOISE_PA    8
+#define SIM_BATT_MV     7800    // 2S pack at rest
+#define SIM_BATT_RINT   0.25    // Ohm
+#define SIM_MOTOR_A     1.6     // full duty
+#define SIM_ADC_NOISE   6       // LSB
+#define SIM_LAG_PA      1500    // pipe gauge level for the response lag
+
+struct sTouchStep {
+    int ms;
+    int pin;               // -1: end
+    bool touched;
+};
+
+struct sScenario {
+    const char *pName;
+    int (*remote)(int ms); // mouthpiece gauge pressure in Pa
+    int outFrom;           // ms, the blow sends nothing from outFrom to outTo
+    int outTo;
+    int ms;                // length of the profile, 0: SIM_MS
+    const sTouchStep *pTouch;
+    int tuneMs;            // ms of the /params request
+    const char *pTune;     // its query, nullptr: none
+};
+
+static int remoteStep(int ms) { return (500 <= ms && ms < 3500) ? 600 : 0; }
+static int remoteRamp(int ms) { return ms < 500 ? 0 : (ms < 2500 ? (ms - 500) * 800 / 2000 : (ms < 4000 ? 800 : 0)); }
+static int remotePuff(int ms) { return ms < 1000 ? 0 : (((ms / 1000) & 1) ? 400 : 100); }
+static int remoteLate(int ms) { return (10000 <= ms && ms < 12000) ? 600 : 0; }
+
+// long TOUCH1 opens the menu, TOUCH2 to Settings, select, TOUCH2 to Mode,
+// select and TOUCH2 switches to stop in the middle of the step
+static const sTouchStep aMenuStop[] = {
+    {1000, TOUCH1, true}, {1900, TOUCH1, false},
+    {2000, TOUCH2, true}, {2100, TOUCH2, false},
+    {2200, TOUCH1, true}, {2300, TOUCH1, false},
+    {2400, TOUCH2, true}, {2500, TOUCH2, false},
+    {2600, TOUCH1, true}, {2700, TOUCH1, false},
+    {2800, TOUCH2, true}, {2900, TOUCH2, false},
+    {0, -1, false}
+};
+
+// same profiles as plantsim, dropout loses the Wi-Fi in the middle of the step,
+// idle waits long enough for the idle mode before the step, tune lowers the
+// gain and the deadband in the middle of the step and saves them
+static const sScenario aScenario[] = {
+    {"step",    remoteStep, 0, 0, 0, nullptr, 0, nullptr},
+    {"ramp",    remoteRamp, 0, 0, 0, nullptr, 0, nullptr},
+    {"puffs",   remotePuff, 0, 0, 0, nullptr, 0, nullptr},
+    {"dropout", remoteStep, 1500, 2500, 0, nullptr, 0, nullptr},
+    {"idle",    remoteLate, 0, 0, 14000, nullptr, 0, nullptr},
+    {"menu",    remoteStep, 0, 0, 0, aMenuStop, 0, nullptr},
+    {"tune",    remoteStep, 0, 0, 0, nullptr, 2000, "gain=3&deadband=30&save=1"},
+    {nullptr, nullptr, 0, 0, 0, nullptr, 0, nullptr}
+};
+
+static uint32_t simRand = 12345;
+static uint32_t simAdcRand = 67890; // ADC noise, does not shift the network sequence
+
+static uint32_t
+nextRand(uint32_t &state = simRand)
+{
+    state ^= state << 13; // xorshift, the same run every time
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// the blow device: samples, batches, echoes
+class cSimBlow {
+    uint64_t nextUs;
+    uint16_t seq;
+    uint32_t lastRtt;
+    sUDPPacket pkt;
+    cLinkStats stats;
+    cClockSync clock;
+    public:
+    uint32_t lost = 0;
+    uint32_t rtts = 0;  // round trips measured
+
+    cSimBlow() : nextUs(0), seq(0), lastRtt(0) { memset(&pkt, 0, sizeof(pkt)); }
+
+    void begin(uint64_t now) { nextUs = now; }
+
+    void send(uint64_t now, bool linkUp) {
+        uint8_t aBuf[V2_MAX_SIZE];
+        uint32_t blowNow = (uint32_t) (now + SIM_BLOW_CLOCK);
+
+        pkt.seq = seq++;
+        pkt.hasRtt = lastRtt != 0; // once per measurement like sendBlowPacket()
+        pkt.rtt = lastRtt;
+        lastRtt = 0;
+        pkt.hasClock = clock.isSynced();
+        if (pkt.hasClock) {
+            uint32_t err = clock.getDelay() / 2;
+            pkt.offset = clock.offsetAt(pkt.aSample[0].time);
+            pkt.clockErr = err < 0xffff ? err : 0xffff;
+        }
+        int len = udpEncodeV2(aBuf, pkt);
+        stats.onSend(pkt.seq, blowNow);
+        pkt.count = 0;
+        pkt.hasStatus = false;
+        if (!linkUp || nextRand() % 100 < SIM_LOSS_PCT) {
+            lost++;
+            return;
+        }
+        sSimDatagram dgram = { now + SIM_NET_US + nextRand() % SIM_JITTER_US, std::vector<uint8_t>(aBuf, aBuf + len) };
+        auto pos = simUdpRx.end();
+        while (pos != simUdpRx.begin() && dgram.due < (pos - 1)->due) {
+            pos--; // reordered by the jitter
+        }
+        simUdpRx.insert(pos, dgram);
+    }
+
+    void step(uint64_t now, int32_t gaugePa, bool linkUp) {
+        while (!simUdpTx.empty() && simUdpTx.front().due + SIM_NET_US <= now) {
+            sUDPEcho echo;
+            const std::vector<uint8_t> &data = simUdpTx.front().data;
+            uint32_t blowNow = (uint32_t) (simUdpTx.front().due + SIM_NET_US + SIM_BLOW_CLOCK);
+            if (udpDecodeEcho(data.data(), data.size(), echo)) {
+                uint32_t rtt = stats.onEcho(echo.seq, blowNow);
+                if (rtt) {
+                    lastRtt = rtt;
+                    rtts++;
+                    clock.add(blowNow - rtt, echo.rxTime, echo.txTime, blowNow);
+                }
+            }
+            simUdpTx.pop_front();
+        }
+        while (nextUs <= now) {
+            sUDPSample sample = { (uint32_t) (nextUs + SIM_BLOW_CLOCK),
+                                  (int32_t) (SIM_BLOW_PA + gaugePa + (int32_t) (nextRand() % (2*SIM_NOISE_PA + 1)) - SIM_NOISE_PA) };
+            if (!udpFitsV2(pkt, sample)) {
+                send(nextUs, linkUp);
+            }
+            pkt.aSample[pkt.count++] = sample;
+            if (pkt.count == 1 && seq % (BLOW_STATUS_MS * BLOW_SAMPLE_HZ / 1000 / BLOW_BATCH) == 0) {
+                pkt.hasStatus = true;
+                pkt.mvolt = 7600;
+                pkt.temp = 21;
+            }
+            if (BLOW_BATCH <= pkt.count) {
+                send(nextUs, linkUp);
+            }
+            nextUs += 1000000 / BLOW_SAMPLE_HZ;
+        }
+    }
+};
+
+struct sQuality {
+    double settleMs;  // after the first setpoint step, -1 never settled
+    double overshoot; // percent of the first step
+    double rippleRms; // Pa, error while the setpoint is constant
+    unsigned switches;
+    double riseLagMs; // pipe after the target crossing SIM_LAG_PA upwards, -1 never
+    double fallLagMs; // and downwards again
+};
+
+static cSimM24C02 simEeprom;
+static cSimMS5607 simSensor;
+static cSimSH1106 simOled;
+static cPlant plant(sPlantParam{ 10000.0, 0.30, 0.05, 0.08, 40.0, 0.010, 1.0 });
+
+static void
+setupWorld(const char *pName)
+{
+    Wire.attach(0x3c, &simOled);
+    Wire1.attach(0x50, &simEeprom);
+    Wire1.attach(0x76, &simSensor);
+    // device name, password and SSID at the fixed offsets used before cCfgStore
+    memset(simEeprom.aMem, 0, 64);
+    strcpy((char *) simEeprom.aMem + 16, "Pipe-sim");
+    strcpy((char *) simEeprom.aMem + 32, "simsimsim");
+    strcpy((char *) simEeprom.aMem + 48, "Pipe-sim");
+    simSensor.pressure = []() { return (int32_t) SIM_AMBIENT_PA + plant.sensor(); };
+    aSimAdc[ADC1] = SIM_BATT_MV * 4096 / (3230 * 11);
+    simFsRoot = std::string("/tmp/firmsim_") + pName;
+    for (int idx = 0; idx < FREC_FILES; idx++) {
+        char aPath[16];
+        cFlightRec::getPath(aPath, idx);
+        LittleFS.remove(aPath);
+    }
+}
+
+// url with the query (GET) or the form fields (POST) through the mock server,
+// returns the status code
+static int
+simRequest(const char *pUrl, const char *pQuery, String &body, int method = HTTP_GET)
+{
+    AsyncWebServerRequest req;
+    std::string query = pQuery ? pQuery : "";
+    req.url = pUrl;
+    req.method = method;
+    for (size_t pos = 0; pos < query.size(); ) {
+        size_t end = query.find('&', pos);
+        end = end == std::string::npos ? query.size() : end;
+        std::string item = query.substr(pos, end - pos);
+        size_t eq = item.find('=');
+        req.params.push_back(AsyncWebParameter(item.substr(0, eq).c_str(),
+                                               eq == std::string::npos ? "" : item.substr(eq + 1).c_str()));
+        pos = end + 1;
+    }
+    server.request(&req);
+    body = req.body;
+    return req.code;
+}
+
+static double
+wallMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// pBase: the same scenario without the slope feedforward, nullptr: run it
+// without the feedforward and without a report
+static sQuality
+runScenario(const sScenario &sc, const sQuality *pBase)
+{
+    cSimBlow blow;
+    sQuality res = { -1.0, 0.0, 0.0, 0, -1.0, -1.0 };
+    int targetUp = -1, targetDown = -1, pipeUp = -1, pipeDown = -1;
+    int32_t target = 0, firstStep = 0;
+    int stepMs = -1, lastChange = 0, lastDir = 0, lastActive = -1;
+    int idleAt = -1, wakeAt = -1;
+    int idleHz = 0, wakeHz = 0; // controller rate two ticks after idleAt/wakeAt
+    int syncedAt = -1, unsyncedMs = 0; // pipe without the blow clock after the first sync
+    int stopAt = -1, lastDriven = -1;
+    int nanCode = 0, getCode = 0;
+    String nanJson, getJson;
+    int tuneCode = 0, badCode = 0, tuneAt = -1, appliedAt = -1;
+    uint32_t flashStalls = 0, flashActive = 0, flashMaxUs = 0, flashActiveMaxUs = 0;
+    String tuneJson, badJson;
+    const sTouchStep *pTouch = sc.pTouch;
+    int rawMin = 99999, rawMax = 0, estMin = 99999, estMax = 0;
+    double peak = 0.0, rippleSum = 0.0;
+    int rippleCnt = 0;
+    unsigned long loops = 0, dispSteps = 0;
+    bool profiling = false;
+    char aLine[192];
+
+    setupWorld(sc.pName);
+    double wallStart = wallMs();
+    simCore = SIM_CTRL;
+    setup();
+    aSimUs[SIM_DISP] = aSimUs[SIM_CTRL];
+    simCore = SIM_DISP;
+    touchInput.begin(aTouchSensor); // displayTask() is not started
+    simCore = SIM_CTRL;
+    uint64_t start = aSimUs[SIM_CTRL];
+    uint64_t end = start + (SIM_IDLE_MS + (sc.ms ? sc.ms : SIM_MS)) * 1000ULL;
+    uint64_t plantUs = start;
+    uint32_t i2c0 = Wire.getBytes(), i2c1 = Wire1.getBytes();
+    uint64_t busy0 = Wire.getBusyUs(), busy1 = Wire1.getBusyUs();
+    uint32_t frames = simOled.frames;
+    uint32_t udpRx = Udp.rxDatagrams, udpRxB = Udp.rxBytes, udpTx = Udp.txDatagrams, udpTxB = Udp.txBytes;
+    blow.begin(start);
+    ctrlTick.resetStats();
+    pipeParams.set("lead", pBase ? PIPE_LEAD_MS : 0);
+
+    while (true) {
+        if (aSimUs[SIM_CTRL] <= aSimUs[SIM_DISP]) {
+            simCore = SIM_CTRL;
+            uint64_t now = aSimUs[SIM_CTRL];
+            if (end <= now) {
+                break;
+            }
+            if (simFlashFrom <= now && now < simFlashUntil) {
+                // the display core writes the flash, this core stands still
+                uint32_t stall = (uint32_t) (simFlashUntil - now);
+                bool active = !power.isIdle() && pipeMode == PIPE_MODE_RUN; // may drive motor/vent
+                flashStalls++;
+                flashMaxUs = stall > flashMaxUs ? stall : flashMaxUs;
+                flashActive += active;
+                flashActiveMaxUs = active && stall > flashActiveMaxUs ? stall : flashActiveMaxUs;
+                aSimUs[SIM_CTRL] = simFlashUntil;
+                continue;
+            }
+            while (plantUs + SIM_PLANT_US <= now) {
+                plant.step(motor.duty(), vent.duty(), SIM_PLANT_US / 1e6);
+                plantUs += SIM_PLANT_US;
+                double battMv = SIM_BATT_MV - 1000.0 * SIM_BATT_RINT * SIM_MOTOR_A * motor.duty() / 255;
+                aSimAdc[ADC1] = (int) (battMv * 4096 / (3230 * 11)) + (int) (nextRand(simAdcRand) % (2*SIM_ADC_NOISE + 1)) - SIM_ADC_NOISE;
+                int ms = (int) ((plantUs - start) / 1000) - SIM_IDLE_MS;
+                if (ms < 0 || (plantUs - start) % 1000) {
+                    continue;
+                }
+                // quality like plantsim, once per ms
+                int32_t sp = pipeParam.gain * sc.remote(ms);
+                if (sp != target) {
+                    if (stepMs < 0 && 0 < sp) {
+                        stepMs = ms;
+                        firstStep = sp;
+                    }
+                    lastChange = ms;
+                    target = sp;
+                }
+                double p = plant.gauge();
+                if (targetUp < 0 && SIM_LAG_PA <= sp) {
+                    targetUp = ms;
+                } else if (0 <= targetUp && targetDown < 0 && sp < SIM_LAG_PA) {
+                    targetDown = ms;
+                }
+                if (0 <= targetUp && pipeUp < 0 && SIM_LAG_PA <= p) {
+                    pipeUp = ms;
+                } else if (0 <= targetDown && 0 <= pipeUp && pipeDown < 0 && p < SIM_LAG_PA) {
+                    pipeDown = ms;
+                }
+                if (0 <= stepMs && target == firstStep) {
+                    peak = p > peak ? p : peak;
+                    double band = firstStep * 0.05 > 100.0 ? firstStep * 0.05 : 100.0;
+                    if (fabs(p - firstStep) > band) {
+                        res.settleMs = -1.0;
+                    } else if (res.settleMs < 0) {
+                        res.settleMs = ms - stepMs;
+                    }
+                }
+                if (500 < ms - lastChange) {
+                    rippleSum += (p - target) * (p - target);
+                    rippleCnt++;
+                }
+                int dir = motor.duty() ? 1 : (vent.duty() ? -1 : 0);
+                res.switches += dir != lastDir;
+                lastDir = dir;
+                if (dir && sc.outFrom <= ms && ms < sc.outTo) {
+                    lastActive = ms; // still driven without the blow
+                }
+                if (stopAt < 0 && pipeMode != PIPE_MODE_RUN) {
+                    stopAt = ms;
+                }
+                if (dir && 0 <= stopAt) {
+                    lastDriven = ms; // still driven after the stop
+                }
+                if (tuneCode && appliedAt < 0 && tuneAt <= ms && pipeParam.gain == pipeParams.get("gain") &&
+                    pipeCtrl.getParam().deadband == pipeParams.get("deadband")) {
+                    appliedAt = ms;
+                }
+                int rawMv = ADC2MV(aSimAdc[ADC1]);
+                rawMin = rawMv < rawMin ? rawMv : rawMin;
+                rawMax = rawMv > rawMax ? rawMv : rawMax;
+                estMin = battery.getMv() < estMin ? battery.getMv() : estMin;
+                estMax = battery.getMv() > estMax ? battery.getMv() : estMax;
+                sPipeState rate;
+                pipeStateLink.peek(rate);
+                if (rate.synced && syncedAt < 0) {
+                    syncedAt = ms;
+                } else if (!rate.synced && 0 <= syncedAt) {
+                    unsyncedMs++;
+                }
+                if (0 <= idleAt && !idleHz && idleAt + 2000 / CTRL_IDLE_HZ <= ms) {
+                    idleHz = rate.ctrlHz;
+                }
+                if (0 <= wakeAt && !wakeHz && wakeAt + 2000 / CTRL_RATE_HZ <= ms) {
+                    wakeHz = rate.ctrlHz;
+                }
+                if (power.isIdle() && idleAt < 0) {
+                    idleAt = ms;
+                } else if (!power.isIdle() && 0 <= idleAt && wakeAt < 0) {
+                    wakeAt = ms;
+                }
+            }
+            int ms = (int) ((now - start) / 1000) - SIM_IDLE_MS;
+            if (!profiling && 0 <= ms) {
+                // /stats covers the profile only
+                AsyncWebServerRequest req;
+                req.url = "/stats";
+                req.params.push_back(AsyncWebParameter("reset", "1"));
+                server.request(&req);
+                profiling = true;
+            }
+            blow.step(now, ms < 0 ? 0 : sc.remote(ms), ms < sc.outFrom || sc.outTo <= ms);
+            loop();
+            loops++;
+            simAdvance(SIM_LOOP_US / 2 + nextRand() % SIM_LOOP_US);
+        } else {
+            simCore = SIM_DISP;
+            int ms = (int) ((aSimUs[SIM_DISP] - start) / 1000) - SIM_IDLE_MS;
+            while (pTouch && 0 <= pTouch->pin && pTouch->ms <= ms) {
+                simTouch(pTouch->pin, pTouch->touched);
+                pTouch++;
+            }
+            if (sc.pTune && !tuneCode && sc.tuneMs <= ms) {
+                // the web task runs on the display core, the EEPROM write takes its time there
+                tuneCode = simRequest("/params", sc.pTune, tuneJson, HTTP_POST);
+                // a bad value must not leave the defaults behind either, a
+                // value that is not a number is not 0, a GET changes nothing
+                badCode = simRequest("/params", "defaults=1&gain=99", badJson, HTTP_POST);
+                nanCode = simRequest("/params", "kp=abc", nanJson, HTTP_POST);
+                getCode = simRequest("/params", "deadband=40", getJson);
+                tuneAt = ms; // the display core may be ahead of sc.tuneMs
+            }
+            if (dispTick.due(micros())) {
+                displayStep();
+                dispSteps++;
+            }
+            vTaskDelay(1);
+        }
+    }
+    double wall = wallMs() - wallStart;
+    sPipeState pipeShown;
+    pipeStateLink.peek(pipeShown);
+    double simS = (end - start) / 1e6;
+    if (0 < firstStep) {
+        res.overshoot = peak > firstStep ? 100.0 * (peak - firstStep) / firstStep : 0.0;
+    }
+    res.rippleRms = rippleCnt ? sqrt(rippleSum / rippleCnt) : 0.0;
+    res.riseLagMs = 0 <= pipeUp ? pipeUp - targetUp : -1.0;
+    res.fallLagMs = 0 <= pipeDown ? pipeDown - targetDown : -1.0;
+    if (!pBase) {
+        return res;
+    }
+
+    printf("== %s: %.1f s simulated in %.0f ms wall, %.0fx real time\n", sc.pName, simS, wall, simS * 1000.0 / wall);
+    printf("loop      %.0f passes/s, control %.1f ticks/s, late avg %lu us max %lu us, missed %lu\n",
+           loops / simS, ctrlTick.getCount() / simS, ctrlTick.getLateAvg(), ctrlTick.getLateMax(), ctrlTick.getMissed());
+    printf("control   settle %.0f ms, overshoot %.1f%%, ripple %.1f Pa, %u switches, latency p50 %lu us p99 %lu us\n",
+           res.settleMs, res.overshoot, res.rippleRms, res.switches,
+           (unsigned long) pipeShown.latP50, (unsigned long) pipeShown.latP99);
+    printf("lead      %d Pa, pump %d ms: rise lag %.0f -> %.0f ms, fall lag %.0f -> %.0f ms, settle %.0f -> %.0f ms, overshoot %.1f -> %.1f%%\n",
+           SIM_LAG_PA, pipeShown.pumpMs, pBase->riseLagMs, res.riseLagMs, pBase->fallLagMs, res.fallLagMs,
+           pBase->settleMs, res.settleMs, pBase->overshoot, res.overshoot);
+    printf("I2C       Wire %.0f B/s (%.0f%% busy), Wire1 %.0f B/s (%.0f%% busy), %lu NACK, %u sensor conversions\n",
+           (Wire.getBytes() - i2c0) / simS, (Wire.getBusyUs() - busy0) / (simS * 1e4),
+           (Wire1.getBytes() - i2c1) / simS, (Wire1.getBusyUs() - busy1) / (simS * 1e4),
+           (unsigned long) (Wire.getNacks() + Wire1.getNacks()), simSensor.conversions);
+    printf("UDP       rx %.1f/s %.0f B/s, tx %.1f/s %.0f B/s, %u lost, superseded %lu, stale %lu, RTT %lu at the pipe of %u measured\n",
+           (Udp.rxDatagrams - udpRx) / simS, (Udp.rxBytes - udpRxB) / simS,
+           (Udp.txDatagrams - udpTx) / simS, (Udp.txBytes - udpTxB) / simS, blow.lost,
+           (unsigned long) pipeShown.udp.superseded, (unsigned long) pipeShown.udp.stale,
+           (unsigned long) pipeShown.link.samples, blow.rtts);
+    if (sc.outTo) {
+        printf("dropout   %d ms without the blow, motor/vent off after %d ms, %lu fail-safe, clock not synced for %d ms\n",
+               sc.outTo - sc.outFrom, lastActive < 0 ? 0 : lastActive + 1 - sc.outFrom,
+               (unsigned long) pipeShown.udp.linkLost, unsyncedMs);
+    }
+    if (0 <= idleAt) {
+        power.getStatus(aLine);
+        printf("power     idle at %d ms, back at %d ms (%d ms after the step), %s\n",
+               idleAt, wakeAt, wakeAt < 0 || stepMs < 0 ? -1 : wakeAt - stepMs, aLine);
+        printf("          controller and filter at %d Hz in idle (tick %d Hz), %d Hz after the wake-up (tick %d Hz)%s\n",
+               idleHz, CTRL_IDLE_HZ, wakeHz, CTRL_RATE_HZ,
+               idleHz == CTRL_IDLE_HZ && wakeHz == CTRL_RATE_HZ ? "" : ", MISMATCH");
+    }
+    battery.getStatus(aLine, "pipe");
+    printf("battery   %d mV at rest, one reading %d..%d mV, estimate %d..%d mV, %s\n",
+           SIM_BATT_MV, rawMin, rawMax, estMin, estMax, aLine);
+    blowBattery.getStatus(aLine, "blow");
+    printf("          %s\n", aLine);
+    adcScan.getStatus(aLine);
+    printf("          %s\n", aLine);
+    if (sc.pTouch) {
+        printf("menu      title '%s', stop at %d ms, motor/vent off after %d ms\n",
+               pCurDispItems->pDevTitle->aText, stopAt, lastDriven < 0 ? 0 : lastDriven + 1 - stopAt);
+    }
+    if (sc.pTune) {
+        cParamTable reload;
+        reload.begin(true);
+        uint8_t aRec[CFG_REC_MAX];
+        printf("params    record %d bytes, %d bytes free in bank %d (generation %u)\n",
+               cfg.get(REC_PIPE_PARAM, aRec, sizeof(aRec)), cfg.getFree(), cfg.getBank(), cfg.getGeneration());
+        printf("params    %s at %d ms: %d, in use after %d ms, after a reload gain %ld deadband %ld\n"
+               "          defaults=1&gain=99: %d %s, deadband still %ld\n"
+               "          kp=abc: %d %s, kp still %ld, GET deadband=40: %d, deadband still %ld\n          %s\n",
+               sc.pTune, tuneAt, tuneCode, appliedAt - tuneAt, (long) reload.get("gain"),
+               (long) reload.get("deadband"), badCode, badJson.c_str(), (long) pipeParams.get("deadband"),
+               nanCode, nanJson.c_str(), (long) pipeParams.get("kp"), getCode, (long) pipeParams.get("deadband"),
+               tuneJson.c_str());
+    }
+    printf("display   %.1f steps/s, %.1f frames/s\n", dispSteps / simS, (simOled.frames - frames) / simS);
+    flightRec.getStatus(aLine);
+    printf("%s, in %s\n", aLine, simFsRoot.c_str());
+    printf("flash     control core held %u times, max %u us, while active %u times, max %u us\n",
+           flashStalls, flashMaxUs, flashActive, flashActiveMaxUs);
+    AsyncWebServerRequest req;
+    req.url = "/stats";
+    server.request(&req);
+    printf("%s", req.body.c_str());
+    return res;
+}
+
+int
+main(int argc, char **argv)
+{
+    for (const sScenario *pSc = aScenario; pSc->pName; pSc++) {
+        bool selected = argc < 2;
+        for (int idx = 1; idx < argc; idx++) {
+            selected |= strcmp(argv[idx], pSc->pName) == 0;
+        }
+        if (!selected) {
+            continue;
+        }
+        // without the feedforward first, the result comes back through a pipe
+        sQuality base = { -1.0, 0.0, 0.0, 0, -1.0, -1.0 };
+        int aFd[2];
+        fflush(stdout);
+        if (pipe(aFd) != 0) {
+            return 1;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            sQuality res = runScenario(*pSc, nullptr);
+            _exit(write(aFd[1], &res, sizeof(res)) == sizeof(res) ? 0 : 1);
+        }
+        close(aFd[1]);
+        if (read(aFd[0], &base, sizeof(base)) != sizeof(base)) {
+            printf("== %s: failed without the feedforward\n", pSc->pName);
+        }
+        close(aFd[0]);
+        int status = 0;
+        waitpid(pid, &status, 0);
+        pid = fork();
+        if (pid == 0) {
+            runScenario(*pSc, &base);
+            fflush(stdout);
+            _exit(0);
+        }
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            printf("== %s: failed (status %d)\n", pSc->pName, status);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Decode a flight recorder file (download from /rec) into CSV on stdout:
+ * session, ms since the session start, local/remote/setpoint Pa, duty, mV.
+ * Blocks of other sessions are skipped after the first one unless -a is given,
+ * a gap line is printed where the pipe dropped records.
+ *
+ * Build: make -C blowpipecode/sim frecdump
+ * Usage: frecdump [-a] rec0.bin
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "../frecord.h"
+
+int
+main(int argc, char **argv)
+{
+    bool all = 1 < argc && strcmp(argv[1], "-a") == 0;
+    const char *pName = argv[argc - 1];
+    FILE *pFile = 1 < argc ? fopen(pName, "rb") : nullptr;
+    uint8_t aBlock[FREC_BLOCK];
+    bool first = true;
+    uint16_t session = 0;
+    uint32_t start = 0;
+    unsigned long blocks = 0, records = 0, bad = 0;
+
+    if (pFile == nullptr) {
+        fprintf(stderr, "usage: %s [-a] recN.bin\n", argv[0]);
+        return 1;
+    }
+    printf("session,ms,localPa,remotePa,setpointPa,duty,mV\n");
+    while (fread(aBlock, 1, FREC_BLOCK, pFile) == FREC_BLOCK) {
+        cFrecDecoder dec;
+        sFrecSample s;
+        if (!dec.start(aBlock)) {
+            bad++;
+            continue;
+        }
+        if (first) {
+            session = dec.head.session;
+            start = dec.head.time0;
+            first = false;
+        } else if (dec.head.session != session && !all) {
+            continue;
+        }
+        if (dec.head.dropped) {
+            printf("# gap: %u records dropped\n", dec.head.dropped);
+        }
+        blocks++;
+        while (dec.next(s)) {
+            printf("%u,%.3f,%ld,%ld,%ld,%ld,%ld\n", dec.head.session, (uint32_t) (s.time - start) / 1000.0,
+                   (long) s.localPa, (long) s.remotePa, (long) s.setpointPa, (long) s.duty, (long) s.mV);
+            records++;
+        }
+    }
+    fclose(pFile);
+    fprintf(stderr, "%lu blocks, %lu records, %lu invalid blocks\n", blocks, records, bad);
+    return 0;
+}
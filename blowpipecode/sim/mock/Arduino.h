@@ -0,0 +1,129 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Host mock of the Arduino core for the firmware simulation (sim/firmsim)
+ * Time: every simulated core has its own virtual clock in aSimUs, simCore
+ *   selects the one millis()/micros() read, simAdvance(us) moves it forward.
+ *   delay() and the I2C transfers advance the clock of the running core.
+ * analogRead(pin): aSimAdc[pin], set by the harness
+ * analogContinuous*(): frames complete on the clock of the reading core, the
+ *   driver keeps the newest SIM_ADC_FRAMES, the values come from aSimAdc
+ * touchAttachInterruptArg(): recorded, simTouch(pin, touched) runs the handler
+ * FreeRTOS: tasks are recorded, not started, queues are plain FIFOs
+ */
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <atomic>
+
+#define PROGMEM
+#define IRAM_ATTR
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+#define LOW          0
+#define HIGH         1
+#define LED_BUILTIN  25
+
+typedef uint8_t byte;
+
+// simulation control
+#define SIM_CORES 2
+#define SIM_PINS  64
+extern uint64_t aSimUs[SIM_CORES];
+extern int simCore;
+extern int aSimAdc[SIM_PINS];
+void simAdvance(uint32_t us);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int val);
+int analogRead(int pin);
+void analogReadResolution(int bits);
+
+#define SIM_ADC_FRAMES 2
+typedef struct {
+    uint8_t pin;
+    uint8_t channel;
+    int avg_read_raw;
+    int avg_read_mvolts;
+} adc_continuous_data_t;
+bool analogContinuous(const uint8_t pins[], size_t pins_count, uint32_t conversions_per_pin,
+                      uint32_t sampling_freq_hz, void (*userFunc)(void));
+bool analogContinuousStart();
+bool analogContinuousRead(adc_continuous_data_t **buffer, uint32_t timeout_ms);
+int touchRead(int pin);
+void touchAttachInterruptArg(uint8_t pin, void (*userFunc)(void *), void *arg, uint32_t threshold);
+bool touchInterruptGetLastStatus(uint8_t pin);
+void simTouch(int pin, bool touched);
+void yield();
+
+class String : public std::string {
+    public:
+    String() {}
+    String(const char *p) : std::string(p) {}
+    String(const std::string &s) : std::string(s) {}
+    String(int val) : std::string(std::to_string(val)) {}
+    void toCharArray(char *p, unsigned n) const { strncpy(p, c_str(), n); if (n) p[n - 1] = 0; }
+    int toInt() const { return atoi(c_str()); }
+};
+inline String operator+(const char *a, const String &b) { return String(std::string(a) + b); }
+
+class HardwareSerial {
+    public:
+    bool echo = false; // print to stdout
+    void begin(int) {}
+    int printf(const char *pFmt, ...) __attribute__((format(printf, 2, 3)));
+    void println(const char *pStr) { if (echo) puts(pStr); }
+    void print(const char *pStr) { if (echo) fputs(pStr, stdout); }
+};
+extern HardwareSerial Serial;
+
+class IPAddress {
+    uint8_t a[4];
+    public:
+    IPAddress(uint8_t a0 = 0, uint8_t a1 = 0, uint8_t a2 = 0, uint8_t a3 = 0) { a[0] = a0; a[1] = a1; a[2] = a2; a[3] = a3; }
+    uint8_t &operator[](int idx) { return a[idx]; }
+    bool operator==(const IPAddress &o) const { return memcmp(a, o.a, 4) == 0; }
+    String toString() const {
+        char aBuf[20];
+        snprintf(aBuf, sizeof(aBuf), "%d.%d.%d.%d", a[0], a[1], a[2], a[3]);
+        return String(aBuf);
+    }
+};
+
+class EspClass {
+    public:
+    void restart();
+    uint32_t getCycleCount();
+    uint32_t getCpuFreqMHz() { return 240; }
+    uint32_t getFreeHeap() { return 200000; }
+};
+extern EspClass ESP;
+
+typedef void (*TaskFunction_t)(void *);
+typedef void *TaskHandle_t;
+typedef void *QueueHandle_t;
+typedef int BaseType_t;
+#define portMAX_DELAY 0xffffffff
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *pName, uint32_t stack, void *pArg,
+                                   int prio, TaskHandle_t *pHandle, int core);
+void vTaskDelay(uint32_t ticks);
+QueueHandle_t xQueueCreate(int len, int size);
+BaseType_t xQueueSend(QueueHandle_t q, const void *pItem, uint32_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t q, void *pItem, uint32_t ticks);
+
+#endif // ARDUINO_H
@@ -0,0 +1,24 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Host mock of the DRV8837 motor driver, the harness reads speed/awake
+ */
+#ifndef DRV8837_H
+#define DRV8837_H
+
+class DRV8837 {
+    public:
+    int pinS, pin1, pin2;
+    int speed;  // as passed to run(), the vent gets a negative duty
+    bool awake;
+    DRV8837(int s, int a, int b) : pinS(s), pin1(a), pin2(b), speed(0), awake(false) {}
+    void run(int val) { speed = val; }
+    void setAwake(bool on) { awake = on; }
+    int duty() const { return awake ? (speed < 0 ? -speed : speed) : 0; }
+};
+
+#endif // DRV8837_H
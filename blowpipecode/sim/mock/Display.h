@@ -0,0 +1,97 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Host mock of the SH1106 display library: the items keep their values,
+ * refresh() pushes a full frame (8 pages) over I2C to 0x3C like the real one
+ */
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include "Arduino.h"
+#include "Wire.h"
+
+struct sTouchSensor;
+typedef int (*tTouchCB)(sTouchSensor *, bool);
+struct sTouchSensor { int pin; int samples; int threshold; int hysteresis; tTouchCB cb; };
+struct sMenueInfo { int id; const char *pName; };
+
+class cMenueInfo {
+    public:
+    sTouchSensor *pTouch;
+    sMenueInfo *pMenu;
+    cMenueInfo(sTouchSensor *pT, sMenueInfo *pM) : pTouch(pT), pMenu(pM) {}
+};
+
+class cDisplayItem {
+    public:
+    int x, y;
+    cDisplayItem *pNext = nullptr;
+    cDisplayItem(int xx, int yy, cDisplayItem *pPrev) : x(xx), y(yy) {
+        if (pPrev) {
+            while (pPrev->pNext) {
+                pPrev = pPrev->pNext;
+            }
+            pPrev->pNext = this;
+        }
+    }
+    virtual ~cDisplayItem() {}
+};
+
+class cBoxItem : public cDisplayItem {
+    public:
+    cBoxItem(int x, int y, int w, int h, cDisplayItem *pPrev = nullptr) : cDisplayItem(x, y, pPrev) {}
+};
+
+class cTextItem : public cDisplayItem {
+    public:
+    char aText[32];
+    cTextItem(int x, int y, const char *pText, cDisplayItem *pPrev = nullptr) : cDisplayItem(x, y, pPrev) { updateText(pText); }
+    void updateText(const char *pText) { strncpy(aText, pText, sizeof(aText) - 1); aText[sizeof(aText) - 1] = 0; }
+};
+
+class cTextStrItem : public cDisplayItem {
+    public:
+    const char *pFmt;
+    char aVal[32];
+    cTextStrItem(int x, int y, const char *pF, cDisplayItem *pPrev = nullptr) : cDisplayItem(x, y, pPrev), pFmt(pF) { aVal[0] = 0; }
+    void setValue(const char *pVal) { strncpy(aVal, pVal, sizeof(aVal) - 1); aVal[sizeof(aVal) - 1] = 0; }
+};
+
+class cTextIntItem : public cDisplayItem {
+    public:
+    const char *pFmt;
+    int value = 0;
+    int decimals = 0;
+    bool inverted = false;
+    cTextIntItem(int x, int y, const char *pF, cDisplayItem *pPrev = nullptr) : cDisplayItem(x, y, pPrev), pFmt(pF) {}
+    cTextIntItem(int x, int y, const char *pF, int d, cDisplayItem *pPrev) : cDisplayItem(x, y, pPrev), pFmt(pF), decimals(d) {}
+    void setValue(int val) { value = val; }
+    void setInverted(bool on) { inverted = on; }
+};
+
+class cIconItem : public cDisplayItem {
+    public:
+    const uint8_t *pIcon = nullptr;
+    cIconItem(int x, int y, int w, int h, cDisplayItem *pPrev = nullptr) : cDisplayItem(x, y, pPrev) {}
+    void setValue(const uint8_t *pI) { pIcon = pI; }
+};
+
+class cDisplay {
+    public:
+    bool useWire1;
+    cDisplayItem *apItems[8] = {};
+    unsigned refreshCount = 0;
+    cDisplay(bool w) : useWire1(w) {}
+    TwoWire *getI2C() { return useWire1 ? &Wire1 : &Wire; }
+    void init() {}
+    void addItem(int idx, cDisplayItem *pItem) { apItems[idx] = pItem; }
+    void addMenue(cMenueInfo *pMenu) {}
+    void refresh(int idx);
+    void invertDisplay(bool on) {}
+};
+
+#endif // DISPLAY_H
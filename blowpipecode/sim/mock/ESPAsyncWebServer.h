@@ -0,0 +1,127 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Host mock of ESPAsyncWebServer: handlers are stored, request(pReq) runs the
+ * one registered for pReq->url and pReq->method, the query and the form
+ * fields of a POST are both in params, responses are collected in pReq->body,
+ * chunked responses call the filler with 512 byte chunks until it returns 0
+ */
+#ifndef ESPASYNCWEBSERVER_H
+#define ESPASYNCWEBSERVER_H
+
+#include "Arduino.h"
+#include <functional>
+#include <vector>
+
+enum WebRequestMethod { HTTP_GET = 1, HTTP_POST = 2, HTTP_ANY = 3 };
+
+class AsyncWebParameter {
+    String n;
+    String v;
+    public:
+    AsyncWebParameter(const String &name, const String &val) : n(name), v(val) {}
+    const String &name() const { return n; }
+    const String &value() const { return v; }
+};
+
+typedef std::function<size_t(uint8_t *, size_t, size_t)> AwsResponseFiller;
+
+class AsyncWebServerResponse {
+    public:
+    String body;
+    int code = 200;
+    virtual ~AsyncWebServerResponse() {}
+    void addHeader(const char *pName, const char *pValue) {}
+};
+
+class AsyncWebServerRequest {
+    const AsyncWebParameter *find(const std::vector<AsyncWebParameter> &list, const char *pName) const {
+        for (auto &param : list) {
+            if (param.name() == pName) {
+                return &param;
+            }
+        }
+        return nullptr;
+    }
+    public:
+    String url;
+    int method = HTTP_GET;
+    std::vector<AsyncWebParameter> params;
+    std::vector<AsyncWebParameter> headers;
+    int code = 0;
+    String body;
+
+    const AsyncWebParameter *getParam(const char *pName, bool post = false, bool file = false) const { return find(params, pName); }
+    bool hasParam(const char *pName, bool post = false, bool file = false) const { return getParam(pName) != nullptr; }
+    const AsyncWebParameter *getHeader(const char *pName) const { return find(headers, pName); }
+    bool hasHeader(const char *pName) const { return getHeader(pName) != nullptr; }
+    size_t contentLength() const { return 0; }
+    void send(int c, const char *pType, const String &content) { code = c; body = content; }
+    void send_P(int c, const char *pType, const char *pContent) { code = c; body = pContent; }
+    void send(AsyncWebServerResponse *pResp) { code = pResp->code; body = pResp->body; delete pResp; }
+    AsyncWebServerResponse *beginResponse(int c, const char *pType, const String &content) {
+        AsyncWebServerResponse *pResp = new AsyncWebServerResponse;
+        pResp->code = c;
+        pResp->body = content;
+        return pResp;
+    }
+    AsyncWebServerResponse *beginChunkedResponse(const char *pType, AwsResponseFiller filler) {
+        AsyncWebServerResponse *pResp = new AsyncWebServerResponse;
+        uint8_t aBuf[512];
+        size_t len;
+        while ((len = filler(aBuf, sizeof(aBuf), pResp->body.size())) > 0) {
+            pResp->body.append((const char *) aBuf, len);
+        }
+        return pResp;
+    }
+};
+
+typedef std::function<void(AsyncWebServerRequest *)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *, String, size_t, uint8_t *, size_t, bool)> ArUploadHandlerFunction;
+
+class AsyncWebHandler {
+    public:
+    virtual ~AsyncWebHandler() {}
+};
+
+class AsyncEventSource : public AsyncWebHandler {
+    public:
+    int clients = 0;   // set by the harness
+    uint32_t sent = 0;
+    AsyncEventSource(const char *pUrl) {}
+    void send(const char *pMsg, const char *pEvent = nullptr, uint32_t id = 0, uint32_t reconnect = 0) { sent++; }
+    size_t count() const { return clients; }
+    size_t avgPacketsWaiting() const { return 0; }
+};
+
+class AsyncWebServer {
+    struct sRoute {
+        String url;
+        int method;
+        ArRequestHandlerFunction fn;
+    };
+    std::vector<sRoute> routes;
+    public:
+    AsyncWebServer(int port) {}
+    void on(const char *pUrl, int method, ArRequestHandlerFunction fn) { routes.push_back({ pUrl, method, fn }); }
+    void on(const char *pUrl, int method, ArRequestHandlerFunction fn, ArUploadHandlerFunction upload) { routes.push_back({ pUrl, method, fn }); }
+    void addHandler(AsyncWebHandler *pHandler) {}
+    void begin() {}
+
+    bool request(AsyncWebServerRequest *pReq) {
+        for (auto &route : routes) {
+            if (route.url == pReq->url && (route.method & pReq->method)) {
+                route.fn(pReq);
+                return true;
+            }
+        }
+        pReq->code = 404;
+        return false;
+    }
+};
+
+#endif // ESPASYNCWEBSERVER_H
@@ -0,0 +1,20 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Host mock of ESPmDNS
+ */
+#ifndef ESPMDNS_H
+#define ESPMDNS_H
+
+class MDNSResponder {
+    public:
+    bool begin(const char *pHost) { return true; }
+    void addService(const char *pService, const char *pProto, int port) {}
+};
+extern MDNSResponder MDNS;
+
+#endif // ESPMDNS_H
@@ -0,0 +1,74 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Host mock of LittleFS on a directory of the host, simFsRoot (default /tmp/firmsim_fs)
+ * Flash timing: a write costs SIM_FLASH_PAGE_US per page and SIM_FLASH_ERASE_US
+ *   for every SIM_FLASH_BLOCK of the file it starts, on the clock of the
+ *   writing core. Like on the chips the other core is paused as well:
+ *   simFlashPause() marks the window, the harness holds the other core there.
+ */
+#ifndef LITTLEFS_H
+#define LITTLEFS_H
+
+#include "Arduino.h"
+#include <memory>
+
+#define SIM_FLASH_PAGE     256
+#define SIM_FLASH_BLOCK    4096
+#define SIM_FLASH_PAGE_US  800
+#define SIM_FLASH_ERASE_US 45000
+
+extern uint64_t simFlashFrom;  // window of the last flash operation, the other core waits
+extern uint64_t simFlashUntil;
+void simFlashPause(uint32_t us);
+
+class File {
+    std::shared_ptr<FILE> pFile; // closed with the last copy, like the ESP32 File
+    public:
+    File(FILE *pF = nullptr) { if (pF) pFile.reset(pF, fclose); }
+    operator bool() const { return pFile != nullptr; }
+    size_t write(const uint8_t *pData, size_t len) {
+        if (!pFile || !len) {
+            return 0;
+        }
+        long pos = ftell(pFile.get());
+        long first = pos % SIM_FLASH_BLOCK ? pos / SIM_FLASH_BLOCK + 1 : pos / SIM_FLASH_BLOCK;
+        long erases = (pos + (long) len - 1) / SIM_FLASH_BLOCK + 1 - first;
+        simFlashPause((len + SIM_FLASH_PAGE - 1) / SIM_FLASH_PAGE * SIM_FLASH_PAGE_US + erases * SIM_FLASH_ERASE_US);
+        return fwrite(pData, 1, len, pFile.get());
+    }
+    size_t read(uint8_t *pData, size_t len) { return pFile ? fread(pData, 1, len, pFile.get()) : 0; }
+    bool seek(size_t pos) { return pFile && fseek(pFile.get(), pos, SEEK_SET) == 0; }
+    size_t size() {
+        if (!pFile) {
+            return 0;
+        }
+        long cur = ftell(pFile.get());
+        fseek(pFile.get(), 0, SEEK_END);
+        long end = ftell(pFile.get());
+        fseek(pFile.get(), cur, SEEK_SET);
+        return end;
+    }
+    void flush() { if (pFile) fflush(pFile.get()); }
+    void close() { pFile.reset(); }
+};
+
+extern std::string simFsRoot;
+
+class LittleFSFS {
+    public:
+    bool begin(bool formatOnFail = false);
+    File open(const String &path, const char *pMode) { return File(fopen((simFsRoot + path).c_str(), pMode)); }
+    bool exists(const String &path);
+    bool remove(const String &path) { return ::remove((simFsRoot + path).c_str()) == 0; }
+    bool rename(const String &from, const String &to) { return ::rename((simFsRoot + from).c_str(), (simFsRoot + to).c_str()) == 0; }
+    size_t totalBytes() { return 1 << 20; }
+    size_t usedBytes() { return 0; }
+};
+extern LittleFSFS LittleFS;
+
+#endif // LITTLEFS_H
@@ -0,0 +1,30 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Host mock of the ESP32 Update, accepts every image
+ */
+#ifndef UPDATE_H
+#define UPDATE_H
+
+#include "Arduino.h"
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+
+class UpdateClass {
+    bool failed = false;
+    size_t written = 0;
+    public:
+    bool begin(size_t size = UPDATE_SIZE_UNKNOWN) { failed = false; written = 0; return true; }
+    size_t write(uint8_t *pData, size_t len) { written += len; return len; }
+    bool end(bool evenIfRemaining = false) { return !failed; }
+    bool hasError() { return failed; }
+    void abort() { failed = true; }
+    const char *errorString() { return "mock"; }
+};
+extern UpdateClass Update;
+
+#endif // UPDATE_H
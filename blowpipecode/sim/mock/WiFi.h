@@ -0,0 +1,41 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Host mock of the Wi-Fi station/AP, always connected
+ */
+#ifndef WIFI_H
+#define WIFI_H
+
+#include "Arduino.h"
+
+#define WIFI_STA 1
+#define WIFI_AP  2
+
+enum {
+    WL_IDLE_STATUS = 0, WL_NO_SSID_AVAIL, WL_SCAN_COMPLETED, WL_CONNECTED,
+    WL_CONNECT_FAILED, WL_CONNECTION_LOST, WL_DISCONNECTED, WL_NO_SHIELD = 255
+};
+
+class WiFiClass {
+    public:
+    int mode(int m) { return 1; }
+    bool softAP(const char *pSSID, const char *pPassword) { return true; }
+    IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+    IPAddress localIP() { return IPAddress(192, 168, 4, 1); }
+    void setAutoReconnect(bool on) {}
+    int begin(const char *pSSID, const char *pPassword, int32_t channel = 0, const uint8_t *pBSSID = nullptr, bool connect = true) { return WL_CONNECTED; }
+    int waitForConnectResult(unsigned long timeout = 15000) { return WL_CONNECTED; }
+    int status() { return WL_CONNECTED; }
+    bool disconnect(bool wifiOff = false) { return true; }
+    int32_t channel() { return 6; }
+    uint8_t *BSSID() { static uint8_t aBSSID[6] = { 2, 0, 0, 0, 0, 1 }; return aBSSID; }
+    int32_t RSSI() { return -50; }
+    bool setSleep(bool on) { return true; }
+};
+extern WiFiClass WiFi;
+
+#endif // WIFI_H
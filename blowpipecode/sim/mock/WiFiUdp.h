@@ -0,0 +1,46 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Host mock of WiFiUDP, one simulated peer
+ * simUdpRx: datagrams to the firmware, visible to parsePacket() once the
+ *   clock of the running core reached due
+ * simUdpTx: datagrams sent by the firmware, stamped with the send time
+ */
+#ifndef WIFIUDP_H
+#define WIFIUDP_H
+
+#include "WiFi.h"
+#include <deque>
+#include <vector>
+
+struct sSimDatagram {
+    uint64_t due;  // us, arrival (rx) or send time (tx)
+    std::vector<uint8_t> data;
+};
+extern std::deque<sSimDatagram> simUdpRx;
+extern std::deque<sSimDatagram> simUdpTx;
+
+class WiFiUDP {
+    sSimDatagram cur;
+    size_t pos = 0;
+    std::vector<uint8_t> out;
+    public:
+    uint32_t rxDatagrams = 0, rxBytes = 0, txDatagrams = 0, txBytes = 0;
+
+    uint8_t begin(uint16_t port) { return 1; }
+    int parsePacket();
+    int read(uint8_t *pData, size_t len);
+    int available() { return cur.data.size() - pos; }
+    int beginPacket(IPAddress ip, uint16_t port) { out.clear(); return 1; }
+    size_t write(const uint8_t *pData, size_t len) { out.insert(out.end(), pData, pData + len); return len; }
+    int endPacket();
+    IPAddress remoteIP() { return IPAddress(192, 168, 4, 2); }
+    uint16_t remotePort() { return 1805; }
+    void flush() {}
+};
+
+#endif // WIFIUDP_H
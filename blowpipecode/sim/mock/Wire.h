@@ -0,0 +1,76 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Host mock of TwoWire, transfers go to attached cI2cDevice models
+ * Every byte (address included) takes 9 clocks of the bus speed on the
+ * virtual clock of the running core, an address without device is NACKed.
+ * attach(addr, pDev): connect a device model
+ * getTransactions()/getBytes()/getNacks()/getBusyUs(): bus traffic
+ */
+#ifndef WIRE_H
+#define WIRE_H
+
+#include "Arduino.h"
+
+#define I2C_BUF 260
+
+class cI2cDevice {
+    public:
+    virtual ~cI2cDevice() {}
+    virtual bool select() { return true; }                    // ACK of the address
+    virtual void receive(const uint8_t *pData, int len) = 0;  // write transfer
+    virtual int transmit(uint8_t *pData, int len) = 0;        // read transfer
+};
+
+class TwoWire {
+    cI2cDevice *apDev[128];
+    uint32_t clock;
+    uint8_t txAddr;
+    uint8_t aTx[I2C_BUF];
+    int txLen;
+    uint8_t aRx[I2C_BUF];
+    int rxLen;
+    int rxPos;
+    uint32_t transactions;
+    uint32_t bytes;
+    uint32_t nacks;
+    uint64_t busyUs;
+
+    void charge(int len);
+    public:
+    TwoWire();
+
+    void attach(uint8_t addr, cI2cDevice *pDev) { apDev[addr & 0x7f] = pDev; }
+
+    void setPins(int sda, int scl) {}
+    void setSDA(int pin) {}
+    void setSCL(int pin) {}
+    void setClock(uint32_t hz) { clock = hz; }
+    void begin() {}
+    void beginTransmission(int addr) { txAddr = addr & 0x7f; txLen = 0; }
+    size_t write(uint8_t val) { if (txLen < I2C_BUF) aTx[txLen++] = val; return 1; }
+    size_t write(const uint8_t *pData, size_t len) { for (size_t idx = 0; idx < len; idx++) write(pData[idx]); return len; }
+    int endTransmission(bool stop = true);
+    int requestFrom(int addr, int len, bool stop = true);
+    int available() { return rxLen - rxPos; }
+    int read() { return rxPos < rxLen ? aRx[rxPos++] : -1; }
+    size_t readBytes(uint8_t *pData, size_t len) {
+        size_t idx;
+        for (idx = 0; idx < len && available(); idx++) {
+            pData[idx] = read();
+        }
+        return idx;
+    }
+
+    uint32_t getTransactions() const { return transactions; }
+    uint32_t getBytes() const { return bytes; }
+    uint32_t getNacks() const { return nacks; }
+    uint64_t getBusyUs() const { return busyUs; }
+};
+extern TwoWire Wire, Wire1;
+
+#endif // WIRE_H
@@ -0,0 +1,306 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Implementation of the host mocks, shared by all simulation targets
+ */
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <deque>
+#include <vector>
+#include "Arduino.h"
+#include "Wire.h"
+#include "WiFi.h"
+#include "WiFiUdp.h"
+#include "ESPmDNS.h"
+#include "Display.h"
+#include "LittleFS.h"
+#include "Update.h"
+
+uint64_t aSimUs[SIM_CORES];
+int simCore;
+int aSimAdc[SIM_PINS];
+
+void simAdvance(uint32_t us) { aSimUs[simCore] += us; }
+
+unsigned long millis() { return aSimUs[simCore] / 1000; }
+unsigned long micros() { return aSimUs[simCore]; }
+void delay(unsigned long ms) { simAdvance(ms * 1000); }
+void delayMicroseconds(unsigned int us) { simAdvance(us); }
+void pinMode(int pin, int mode) {}
+void digitalWrite(int pin, int val) {}
+int analogRead(int pin) { return aSimAdc[pin & (SIM_PINS - 1)]; }
+void analogReadResolution(int bits) {}
+
+static adc_continuous_data_t aSimAdcFrame[8];
+static size_t simAdcPins;
+static uint64_t simAdcFrameUs; // one frame, all pins
+static uint64_t simAdcNext;    // end of the next unread frame
+
+bool
+analogContinuous(const uint8_t pins[], size_t pins_count, uint32_t conversions_per_pin,
+                 uint32_t sampling_freq_hz, void (*userFunc)(void))
+{
+    if (pins_count < 1 || 8 < pins_count || !sampling_freq_hz) {
+        return false;
+    }
+    simAdcPins = pins_count;
+    simAdcFrameUs = 1000000ULL * pins_count * conversions_per_pin / sampling_freq_hz;
+    for (size_t idx = 0; idx < pins_count; idx++) {
+        aSimAdcFrame[idx].pin = pins[idx];
+        aSimAdcFrame[idx].channel = idx;
+    }
+    return true;
+}
+
+bool
+analogContinuousStart()
+{
+    simAdcNext = aSimUs[simCore] + simAdcFrameUs;
+    return simAdcPins != 0;
+}
+
+bool
+analogContinuousRead(adc_continuous_data_t **buffer, uint32_t timeout_ms)
+{
+    uint64_t now = aSimUs[simCore];
+    if (!simAdcPins || now < simAdcNext) {
+        return false;
+    }
+    if (simAdcNext + SIM_ADC_FRAMES * simAdcFrameUs <= now) {
+        // overrun, the older frames are gone
+        simAdcNext += (now - simAdcNext) / simAdcFrameUs * simAdcFrameUs - (SIM_ADC_FRAMES - 1) * simAdcFrameUs;
+    }
+    for (size_t idx = 0; idx < simAdcPins; idx++) {
+        aSimAdcFrame[idx].avg_read_raw = aSimAdc[aSimAdcFrame[idx].pin & (SIM_PINS - 1)];
+        aSimAdcFrame[idx].avg_read_mvolts = aSimAdcFrame[idx].avg_read_raw * 3300 / 4095;
+    }
+    simAdcNext += simAdcFrameUs;
+    *buffer = aSimAdcFrame;
+    return true;
+}
+int touchRead(int pin) { return 20000; } // not touched
+
+struct sSimTouch {
+    void (*pFunc)(void *);
+    void *pArg;
+    bool touched;
+};
+static sSimTouch aSimTouch[SIM_PINS];
+
+void
+touchAttachInterruptArg(uint8_t pin, void (*userFunc)(void *), void *arg, uint32_t threshold)
+{
+    aSimTouch[pin & (SIM_PINS - 1)] = { userFunc, arg, false };
+}
+
+bool touchInterruptGetLastStatus(uint8_t pin) { return aSimTouch[pin & (SIM_PINS - 1)].touched; }
+
+void
+simTouch(int pin, bool touched)
+{
+    sSimTouch &t = aSimTouch[pin & (SIM_PINS - 1)];
+    t.touched = touched;
+    if (t.pFunc) {
+        t.pFunc(t.pArg);
+    }
+}
+void yield() {}
+
+HardwareSerial Serial;
+
+int
+HardwareSerial::printf(const char *pFmt, ...)
+{
+    va_list args;
+    int len = 0;
+    if (echo) {
+        va_start(args, pFmt);
+        len = vprintf(pFmt, args);
+        va_end(args);
+    }
+    return len;
+}
+
+EspClass ESP;
+void EspClass::restart() { printf("restart requested\n"); exit(0); }
+uint32_t EspClass::getCycleCount() { return (uint32_t) (aSimUs[simCore] * 240); }
+
+BaseType_t
+xTaskCreatePinnedToCore(TaskFunction_t fn, const char *pName, uint32_t stack, void *pArg, int prio, TaskHandle_t *pHandle, int core)
+{
+    return 1; // the harness runs the work of the tasks itself
+}
+
+void vTaskDelay(uint32_t ticks) { simAdvance(ticks * 1000); }
+
+struct sSimQueue {
+    int size;
+    std::deque<std::vector<uint8_t>> items;
+};
+
+QueueHandle_t
+xQueueCreate(int len, int size)
+{
+    return new sSimQueue{ size, {} };
+}
+
+BaseType_t
+xQueueSend(QueueHandle_t q, const void *pItem, uint32_t ticks)
+{
+    sSimQueue *pQ = (sSimQueue *) q;
+    pQ->items.emplace_back((const uint8_t *) pItem, (const uint8_t *) pItem + pQ->size);
+    return 1;
+}
+
+BaseType_t
+xQueueReceive(QueueHandle_t q, void *pItem, uint32_t ticks)
+{
+    sSimQueue *pQ = (sSimQueue *) q;
+    if (pQ->items.empty()) {
+        return 0;
+    }
+    memcpy(pItem, pQ->items.front().data(), pQ->size);
+    pQ->items.pop_front();
+    return 1;
+}
+
+TwoWire Wire, Wire1;
+
+TwoWire::TwoWire() : clock(100000), txAddr(0), txLen(0), rxLen(0), rxPos(0), transactions(0), bytes(0), nacks(0), busyUs(0)
+{
+    memset(apDev, 0, sizeof(apDev));
+}
+
+// address and data bytes with ACK: 9 clocks each
+void
+TwoWire::charge(int len)
+{
+    uint32_t us = (uint32_t) ((uint64_t) len * 9 * 1000000 / clock);
+    transactions++;
+    bytes += len;
+    busyUs += us;
+    simAdvance(us);
+}
+
+int
+TwoWire::endTransmission(bool stop)
+{
+    cI2cDevice *pDev = apDev[txAddr];
+    if (pDev == nullptr || !pDev->select()) {
+        charge(1);
+        nacks++;
+        return 2; // address NACK
+    }
+    charge(1 + txLen);
+    pDev->receive(aTx, txLen);
+    return 0;
+}
+
+int
+TwoWire::requestFrom(int addr, int len, bool stop)
+{
+    cI2cDevice *pDev = apDev[addr & 0x7f];
+    rxLen = rxPos = 0;
+    if (pDev == nullptr || !pDev->select()) {
+        charge(1);
+        nacks++;
+        return 0;
+    }
+    len = len < I2C_BUF ? len : I2C_BUF;
+    rxLen = pDev->transmit(aRx, len);
+    charge(1 + rxLen);
+    return rxLen;
+}
+
+// a full frame: 8 pages, each one command and one data transfer
+void
+cDisplay::refresh(int idx)
+{
+    TwoWire *pWire = getI2C();
+    uint8_t aData[129] = { 0x40 };
+    refreshCount++;
+    for (int page = 0; page < 8; page++) {
+        const uint8_t aCmd[4] = { 0x00, (uint8_t) (0xb0 | page), 0x02, 0x10 };
+        pWire->beginTransmission(0x3c);
+        pWire->write(aCmd, sizeof(aCmd));
+        pWire->endTransmission();
+        pWire->beginTransmission(0x3c);
+        pWire->write(aData, sizeof(aData));
+        pWire->endTransmission();
+    }
+}
+
+WiFiClass WiFi;
+MDNSResponder MDNS;
+std::deque<sSimDatagram> simUdpRx;
+std::deque<sSimDatagram> simUdpTx;
+
+int
+WiFiUDP::parsePacket()
+{
+    // the receive queue is ordered by arrival time
+    if (simUdpRx.empty() || aSimUs[simCore] < simUdpRx.front().due) {
+        cur.data.clear();
+        pos = 0;
+        return 0;
+    }
+    cur = simUdpRx.front();
+    simUdpRx.pop_front();
+    pos = 0;
+    rxDatagrams++;
+    rxBytes += cur.data.size();
+    return cur.data.size();
+}
+
+int
+WiFiUDP::read(uint8_t *pData, size_t len)
+{
+    size_t n = cur.data.size() - pos;
+    n = len < n ? len : n;
+    memcpy(pData, cur.data.data() + pos, n);
+    pos += n;
+    return n;
+}
+
+int
+WiFiUDP::endPacket()
+{
+    simUdpTx.push_back({ aSimUs[simCore], out });
+    txDatagrams++;
+    txBytes += out.size();
+    return 1;
+}
+
+std::string simFsRoot = "/tmp/firmsim_fs";
+uint64_t simFlashFrom;
+uint64_t simFlashUntil;
+
+void
+simFlashPause(uint32_t us)
+{
+    simFlashFrom = aSimUs[simCore];
+    simFlashUntil = simFlashFrom + us;
+    simAdvance(us);
+}
+LittleFSFS LittleFS;
+
+bool
+LittleFSFS::begin(bool formatOnFail)
+{
+    mkdir(simFsRoot.c_str(), 0755);
+    struct stat st;
+    return stat(simFsRoot.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool
+LittleFSFS::exists(const String &path)
+{
+    struct stat st;
+    return stat((simFsRoot + path).c_str(), &st) == 0;
+}
+
+UpdateClass Update;
@@ -0,0 +1,143 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * I2C device models for the firmware simulation
+ * cSimM24C02: 256 bytes, 16 byte pages that wrap, busy (NACK) for
+ *   SIM_EEPROM_WRITE_US after every write like the real write cycle
+ * cSimMS5607: PROM with a valid CRC4, D1/D2 conversions with the data sheet
+ *   conversion times, the pressure comes from pressure() at 20.00 C, an ADC
+ *   read before the conversion finished returns 0 like the real sensor
+ * cSimSH1106: accepts everything, counts the frames
+ */
+#ifndef SIMDEV_H
+#define SIMDEV_H
+
+#include <functional>
+#include "Wire.h"
+
+#define SIM_EEPROM_WRITE_US 5000
+
+class cSimM24C02 : public cI2cDevice {
+    uint8_t addr;
+    uint64_t busyUntil;
+    public:
+    uint8_t aMem[256];
+    uint32_t writes;
+
+    cSimM24C02() : addr(0), busyUntil(0), writes(0) { memset(aMem, 0xff, sizeof(aMem)); }
+
+    bool select() override { return busyUntil <= aSimUs[simCore]; }
+
+    void receive(const uint8_t *pData, int len) override {
+        if (len < 1) {
+            return;
+        }
+        addr = pData[0];
+        for (int idx = 1; idx < len; idx++) {
+            aMem[addr] = pData[idx];
+            addr = (addr & 0xf0) | ((addr + 1) & 0x0f); // the page wraps
+        }
+        if (1 < len) {
+            busyUntil = aSimUs[simCore] + SIM_EEPROM_WRITE_US;
+            writes++;
+        }
+    }
+
+    int transmit(uint8_t *pData, int len) override {
+        for (int idx = 0; idx < len; idx++) {
+            pData[idx] = aMem[addr++];
+        }
+        return len;
+    }
+};
+
+class cSimMS5607 : public cI2cDevice {
+    uint16_t aProm[8];
+    uint8_t cmd;          // last command
+    uint64_t convDone;
+    uint32_t adc;         // result of the last conversion
+
+    static uint8_t crc4(const uint16_t *pProm) {
+        uint16_t aCopy[8];
+        uint16_t rem = 0;
+        memcpy(aCopy, pProm, sizeof(aCopy));
+        aCopy[7] &= 0xff00;
+        for (int cnt = 0; cnt < 16; cnt++) {
+            rem ^= (cnt & 1) ? (aCopy[cnt >> 1] & 0xff) : (aCopy[cnt >> 1] >> 8);
+            for (int bit = 8; bit > 0; bit--) {
+                rem = (rem & 0x8000) ? ((rem << 1) ^ 0x3000) : (rem << 1);
+            }
+        }
+        return (rem >> 12) & 0xf;
+    }
+
+    // raw D1 for a pressure in Pa, dT is 0 (D2 = C5 << 8, 20.00 C)
+    uint32_t rawPres(int32_t pa) const {
+        int64_t off = (int64_t) aProm[2] << 17;
+        int64_t sens = (int64_t) aProm[1] << 16;
+        uint32_t d1 = (uint32_t) ((((int64_t) pa << 15) + off) * (1 << 21) / sens);
+        while (((((int64_t) d1 * sens) >> 21) - off) >> 15 < pa) {
+            d1++;
+        }
+        return d1;
+    }
+
+    public:
+    std::function<int32_t()> pressure; // Pa absolute
+    uint32_t conversions;
+
+    cSimMS5607() : cmd(0), convDone(0), adc(0), conversions(0) {
+        static const uint16_t aCoef[8] = { 0x0000, 46372, 43981, 29059, 27842, 31553, 28165, 0x0000 };
+        memcpy(aProm, aCoef, sizeof(aProm));
+        aProm[7] |= crc4(aProm);
+        pressure = []() { return (int32_t) 101325; };
+    }
+
+    void receive(const uint8_t *pData, int len) override {
+        static const uint16_t aConvUs[5] = { 600, 1170, 2280, 4540, 9040 };
+        if (len < 1) {
+            return;
+        }
+        cmd = pData[0];
+        if ((cmd & 0xf0) == 0x40 || (cmd & 0xf0) == 0x50) {
+            adc = (cmd & 0xf0) == 0x40 ? rawPres(pressure()) : (uint32_t) aProm[5] << 8;
+            convDone = aSimUs[simCore] + aConvUs[((cmd & 0x0f) >> 1) % 5];
+            conversions++;
+        }
+    }
+
+    int transmit(uint8_t *pData, int len) override {
+        if ((cmd & 0xf0) == 0xa0) {
+            uint16_t val = aProm[(cmd >> 1) & 7];
+            pData[0] = val >> 8;
+            pData[1] = val;
+            return len < 2 ? len : 2;
+        }
+        if (cmd == 0x00) {
+            uint32_t val = aSimUs[simCore] < convDone ? 0 : adc; // not finished: 0
+            pData[0] = val >> 16;
+            pData[1] = val >> 8;
+            pData[2] = val;
+            adc = 0;
+            return len < 3 ? len : 3;
+        }
+        return 0;
+    }
+};
+
+class cSimSH1106 : public cI2cDevice {
+    public:
+    uint32_t frames = 0;
+    void receive(const uint8_t *pData, int len) override {
+        if (len == 4 && pData[0] == 0x00 && pData[1] == 0xb0) {
+            frames++; // page 0 starts a frame
+        }
+    }
+    int transmit(uint8_t *pData, int len) override { return 0; }
+};
+
+#endif // SIMDEV_H
@@ -0,0 +1,77 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Host side pneumatic model of the blowpipe (pump, pipe + gather volume, vent)
+ * cPlant(param): set up the model
+ * step(motorDuty, ventDuty, dt): advance the model by dt seconds
+ * gauge(): current gauge pressure in Pa inside the pipe
+ * sensor(): gauge pressure as seen by the MS5607 (delayed and quantized)
+ */
+#ifndef PLANT_H
+#define PLANT_H
+
+#include <math.h>
+#include <stdint.h>
+
+struct sPlantParam {
+    double pMax;       // Pa, pressure the pump holds against the leak at full duty
+    double tauLeak;    // s, time constant of the volume leaking through the pipe
+    double tauVent;    // s, time constant of the volume through the open vent
+    double tauMotor;   // s, spin up time constant of the pump
+    double stallDuty;  // duty below the pump does not turn
+    double sensorDelay;// s, pneumatic + conversion delay of the sensor
+    double quantPa;    // Pa, resolution of the value handed to the firmware
+};
+
+static const sPlantParam defaultPlantParam = {
+    10000.0, 0.30, 0.05, 0.08, 40.0, 0.010, 100.0
+};
+
+class cPlant {
+    sPlantParam param;
+    double pressure;   // Pa gauge
+    double speed;      // 0..1 pump speed
+    double aHist[64];  // sensor delay line, 1ms steps
+    int histIdx;
+    public:
+    cPlant(const sPlantParam &p = defaultPlantParam) : param(p) {
+        pressure = 0.0;
+        speed = 0.0;
+        histIdx = 0;
+        for (int idx = 0; idx < 64; idx++) {
+            aHist[idx] = 0.0;
+        }
+    }
+
+    void step(int motorDuty, int ventDuty, double dt) {
+        double target = motorDuty > param.stallDuty ? motorDuty / 255.0 : 0.0;
+        speed += (target - speed) * dt / param.tauMotor;
+
+        double dp = (param.pMax * speed - pressure) / param.tauLeak;
+        if (ventDuty > param.stallDuty) {
+            dp -= pressure * (ventDuty / 255.0) / param.tauVent;
+        }
+        pressure += dp * dt;
+        if (pressure < 0.0) {
+            pressure = 0.0;
+        }
+
+        histIdx = (histIdx + 1) & 63;
+        aHist[histIdx] = pressure;
+    }
+
+    double gauge() const { return pressure; }
+
+    int32_t sensor() const {
+        int delay = (int) (param.sensorDelay * 1000.0);
+        delay = delay > 63 ? 63 : delay;
+        double val = aHist[(histIdx - delay) & 63];
+        return (int32_t) (floor(val / param.quantPa) * param.quantPa);
+    }
+};
+
+#endif // PLANT_H
@@ -0,0 +1,137 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Compare the original bang-bang logic of handlePipe() with cPressureCtrl
+ * against the plant model. Prints settling time, overshoot, ripple and the
+ * number of actuator switches for a set of mouthpiece pressure profiles.
+ *
+ * Build and run: make -C blowpipecode/sim run
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#define CTRL_RATE_HZ 200 // same as setting.h
+#include "plant.h"
+#include "../pressurectrl.h"
+
+#define SIM_MS       6000  // length of one scenario
+#define LOOP_MS        25  // loop() period of the original firmware
+#define REMOTE_MS     250  // Blow -> Pipe packet period
+#define REMOTE_GAIN     5  // nominalRemote = base + 5 * (remote - base)
+
+struct sScenario {
+    const char *pName;
+    int (*remote)(int ms); // mouthpiece gauge pressure in Pa
+};
+
+static int remoteStep(int ms) { return (500 <= ms && ms < 3500) ? 600 : 0; }
+static int remoteRamp(int ms) { return ms < 500 ? 0 : (ms < 2500 ? (ms - 500) * 800 / 2000 : (ms < 4000 ? 800 : 0)); }
+static int remotePuff(int ms) { return ms < 1000 ? 0 : (((ms / 1000) & 1) ? 400 : 100); }
+
+static const sScenario aScenario[] = {
+    {"step 30mbar", remoteStep},
+    {"ramp 40mbar", remoteRamp},
+    {"puffs",       remotePuff},
+    {nullptr, nullptr}
+};
+
+struct sResult {
+    double settleMs;    // after the first setpoint step, -1 never settled
+    double overshoot;   // percent of the first step
+    double rippleRms;   // Pa, error while the setpoint is constant
+    unsigned switches;
+};
+
+// the original handlePipe() decision, both values in Pa
+static int
+bangBang(int32_t setpoint, int32_t measured)
+{
+    if (setpoint < measured - 1000) {
+        return -255;
+    } else if (measured + 1000 < setpoint) {
+        return 255;
+    }
+    return 0;
+}
+
+static sResult
+runScenario(const sScenario &sc, bool usePid)
+{
+    cPlant plant;
+    cPressureCtrl ctrl;
+    sResult res = {-1.0, 0.0, 0.0, 0};
+    int32_t setpoint = 0;
+    int32_t firstStep = 0;
+    int stepMs = -1;
+    int duty = 0;
+    int lastDir = 0;
+    int lastChange = 0;
+    double peak = 0.0;
+    double rippleSum = 0.0;
+    int rippleCnt = 0;
+    int period = usePid ? 1000 / CTRL_RATE_HZ : LOOP_MS;
+
+    for (int ms = 0; ms < SIM_MS; ms++) {
+        if (ms % REMOTE_MS == 0) {
+            // remote arrives as whole mbar
+            int32_t sp = REMOTE_GAIN * (sc.remote(ms) / 100) * 100;
+            if (sp != setpoint) {
+                if (stepMs < 0 && 0 < sp) {
+                    stepMs = ms;
+                    firstStep = sp;
+                }
+                lastChange = ms;
+            }
+            setpoint = sp;
+        }
+
+        if (ms % period == 0) {
+            int32_t meas = plant.sensor();
+            duty = usePid ? ctrl.step(setpoint, meas) : bangBang(setpoint, meas);
+            int dir = duty > 0 ? 1 : (duty < 0 ? -1 : 0);
+            if (dir != lastDir) {
+                res.switches++;
+                lastDir = dir;
+            }
+        }
+        plant.step(duty > 0 ? duty : 0, duty < 0 ? -duty : 0, 0.001);
+
+        double p = plant.gauge();
+        if (0 <= stepMs && setpoint == firstStep) {
+            peak = p > peak ? p : peak;
+            double band = firstStep * 0.05 > 100.0 ? firstStep * 0.05 : 100.0;
+            if (fabs(p - firstStep) > band) {
+                res.settleMs = -1.0;
+            } else if (res.settleMs < 0) {
+                res.settleMs = ms - stepMs;
+            }
+        }
+        if (500 < ms - lastChange) {
+            rippleSum += (p - setpoint) * (p - setpoint);
+            rippleCnt++;
+        }
+    }
+    if (0 < firstStep) {
+        res.overshoot = peak > firstStep ? 100.0 * (peak - firstStep) / firstStep : 0.0;
+    }
+    res.rippleRms = rippleCnt ? sqrt(rippleSum / rippleCnt) : 0.0;
+    return res;
+}
+
+int
+main(int argc, char **argv)
+{
+    printf("%-12s %-9s %10s %10s %10s %9s\n", "scenario", "control", "settle ms", "overshoot", "ripple Pa", "switches");
+    for (const sScenario *pSc = aScenario; pSc->pName; pSc++) {
+        for (int pid = 0; pid < 2; pid++) {
+            sResult res = runScenario(*pSc, pid != 0);
+            printf("%-12s %-9s %10.0f %9.1f%% %10.1f %9u\n", pSc->pName, pid ? "pid" : "bangbang",
+                   res.settleMs, res.overshoot, res.rippleRms, res.switches);
+        }
+    }
+    return 0;
+}
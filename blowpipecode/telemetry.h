@@ -0,0 +1,129 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Live telemetry to a browser as server sent events
+ * cTelemetry(url, rateHz): event source, frames are JSON objects of event "t"
+ *   begin(server): register the event source
+ *   due(now): true when a frame should be built, false without a client
+ *   send(pJson): push a frame, dropped instead of queued when the clients
+ *     together still have more than TELEM_QUEUE_MAX frames waiting, a newer
+ *     one follows, so no single client queues more than that
+ *     The library only reports the mean queue over the clients (rounded
+ *     down, the sum may be up to count() - 1 more), the bound is on the sum:
+ *     a stalled client makes the others drop frames as well.
+ *   setRate(hz), getRate(), getSent(), getDropped(), getClients()
+ * setupLive(server): /live page that shows every field of the frames and a
+ *   pressure chart, /live?hz=N changes the rate
+ * Frames are built and sent on the display core, the control core is not involved.
+ */
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#define TELEM_QUEUE_MAX 4  // frames waiting in all client queues before new ones are dropped
+#define TELEM_JSON_SIZE 320
+
+class cTelemetry {
+    AsyncEventSource events;
+    unsigned long interval;
+    unsigned long last;
+    uint32_t sent;
+    uint32_t dropped;
+    uint32_t id;
+    public:
+    cTelemetry(const char *pUrl, unsigned int rateHz) : events(pUrl) {
+        setRate(rateHz);
+        last = 0;
+        sent = 0;
+        dropped = 0;
+        id = 0;
+    }
+
+    void begin(AsyncWebServer &server) { server.addHandler(&events); }
+
+    void setRate(unsigned int rateHz) {
+        rateHz = rateHz < 1 ? 1 : (DISP_RATE_HZ < rateHz ? DISP_RATE_HZ : rateHz); // sent from the display tick
+        interval = 1000 / rateHz;
+    }
+
+    bool due(unsigned long now) {
+        if (events.count() == 0 || now - last < interval) {
+            return false;
+        }
+        last = now;
+        return true;
+    }
+
+    void send(const char *pJson) {
+        // the sum over the clients, the library rounds the mean down
+        size_t waiting = events.avgPacketsWaiting() * events.count();
+        if (TELEM_QUEUE_MAX < waiting) {
+            dropped++; // slow client, this frame is stale before it goes out
+            return;
+        }
+        events.send(pJson, "t", ++id);
+        sent++;
+    }
+
+    unsigned int getRate() const { return 1000 / interval; }
+    uint32_t getSent() const { return sent; }
+    uint32_t getDropped() const { return dropped; }
+    size_t getClients() { return events.count(); }
+};
+
+extern cTelemetry telemetry;
+
+void
+setupLive(AsyncWebServer &server, const char *pTitle)
+{
+    static const char *pLiveTitle = pTitle;
+    static const char aLiveHead[] =
+    "<!DOCTYPE HTML>"
+    "<html>"
+    "<head>"
+      "<meta name='viewport' content='width=device-width, initial-scale=1'>"
+      "<style>body{font-family:sans-serif}td{padding:2px 8px}td+td{text-align:right;font-family:monospace}</style>"
+      "<title>";
+    static const char aLiveBody[] =
+      "</title>"
+    "</head>"
+    "<body>"
+      "<canvas id='c' width='320' height='160' style='width:100%;max-width:640px;border:1px solid #888'></canvas>"
+      "<table id='v'></table><div id='s'>connecting</div>"
+    "<script>"
+      "var h=[],c=document.getElementById('c'),x=c.getContext('2d'),v=document.getElementById('v');"
+      "var es=new EventSource('/events');"
+      "es.onerror=function(){document.getElementById('s').textContent='disconnected';};"
+      "es.addEventListener('t',function(e){"
+        "var d=JSON.parse(e.data),r='';"
+        "for(var k in d){r+='<tr><td>'+k+'</td><td>'+d[k]+'</td></tr>';}"
+        "v.innerHTML=r;document.getElementById('s').textContent='live';"
+        "h.push(d);if(h.length>c.width)h.shift();"
+        "var lo=1e9,hi=-1e9;h.forEach(function(p){['local','target'].forEach(function(k){if(k in p){lo=Math.min(lo,p[k]);hi=Math.max(hi,p[k]);}});});"
+        "if(hi-lo<10){hi+=5;lo-=5;}"
+        "x.clearRect(0,0,c.width,c.height);"
+        "[['local','#06c'],['target','#c60']].forEach(function(s){"
+          "x.strokeStyle=s[1];x.beginPath();"
+          "h.forEach(function(p,i){if(s[0] in p){var y=c.height-(p[s[0]]-lo)*c.height/(hi-lo);i?x.lineTo(i,y):x.moveTo(i,y);}});"
+          "x.stroke();});"
+      "});"
+    "</script>"
+    "</body>"
+    "</html>";
+
+    telemetry.begin(server);
+    server.on("/live", HTTP_GET, [](AsyncWebServerRequest *pReq) {
+        if (pReq->hasParam("hz")) {
+            telemetry.setRate(pReq->getParam("hz")->value().toInt());
+        }
+        String page = aLiveHead;
+        page += pLiveTitle;
+        page += aLiveBody;
+        pReq->send(200, "text/html", page);
+    });
+}
+
+#endif // TELEMETRY_H
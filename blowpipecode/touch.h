@@ -0,0 +1,268 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Touch pads on threshold interrupts and the menu on top of them
+ * cTouchInput:
+ *   begin(pTable): display core, attaches the threshold interrupt of every pad
+ *     of an sTouchSensor table, the interrupts run on the attaching core
+ *   poll(now): display core, takes the edges of the interrupts, a level that
+ *     is stable for TOUCH_DEBOUNCE_MS is a press or release, held for
+ *     TOUCH_LONG_MS a long press, calls the cb of the table on press/release,
+ *     the times are those of the edges, a display refresh may block poll()
+ *     for longer than a tap
+ *   getEvent(ev): next debounced event, false if none
+ * cTouchMenu: walks an sMenueInfo table, ids 0xN000 are the top level, 0xNM00
+ *   the entries below 0xN000, pads: TOUCH0 back/-, TOUCH1 select (on a short
+ *   release), TOUCH2 next/+
+ *   long TOUCH1 opens the menu, in the menu it ends the editing or goes up
+ *   one level, closes it from the top level
+ *   poll(input, now): display core, consumes the events, shows the menu in
+ *     the title line and the device name (aDevName) again once it is closed,
+ *     presses while it stays closed leave the title alone, the gain goes to
+ *     the control core through pipeParams, the mode through an atomic
+ * RP2040W: no touch hardware, begin() attaches nothing.
+ */
+#ifndef TOUCH_H
+#define TOUCH_H
+
+#include <atomic>
+
+#define TOUCH_PADS        3
+#define TOUCH_DEBOUNCE_MS 40
+#define TOUCH_LONG_MS     800
+
+#define MENU_MAIN     0x1000
+#define MENU_SETTINGS 0x2000
+#define MENU_GAIN     0x2100
+#define MENU_MODE     0x2200
+#define MENU_EXIT     0x3000
+
+#define PIPE_MODE_RUN  0 // follow the blow
+#define PIPE_MODE_STOP 1 // motor and vent off
+
+std::atomic<int> pipeMode(PIPE_MODE_RUN); // written by the menu, read by the control core
+
+enum { TOUCH_PRESS, TOUCH_LONG, TOUCH_RELEASE };
+
+struct sTouchEvent {
+    uint8_t pad;  // index in the sTouchSensor table
+    uint8_t type;
+};
+
+class cTouchInput {
+    struct sEdge {
+        uint8_t pad;
+        bool touched;
+        uint32_t ms;
+    };
+    struct sPad {
+        bool level;         // last edge
+        bool pressed;       // debounced
+        bool longSent;
+        unsigned long since; // ms of the last edge
+    };
+    sTouchSensor *pTable;
+    int pads;
+    sPad aPad[TOUCH_PADS];
+    cSpscRing<sEdge, 16> edges;   // interrupt -> poll()
+    cSpscRing<sTouchEvent, 8> events;
+    uint32_t dropped;
+
+#if ESP32_S3
+    static void IRAM_ATTR onTouch(void *pArg);
+#endif
+
+    void emit(int pad, uint8_t type) {
+        sTouchEvent ev = { (uint8_t) pad, type };
+        dropped += !events.push(ev);
+    }
+
+    // the level of the pad as it was at the time at (ms), on the edge times a
+    // short tap counts even if no poll() fell between its edges
+    void settle(int pad, unsigned long at) {
+        sPad &p = aPad[pad];
+        if (p.level != p.pressed && TOUCH_DEBOUNCE_MS <= at - p.since) {
+            p.pressed = p.level;
+            p.longSent = false;
+            emit(pad, p.pressed ? TOUCH_PRESS : TOUCH_RELEASE);
+            if (pTable[pad].cb) {
+                pTable[pad].cb(pTable + pad, p.pressed);
+            }
+        }
+        if (p.pressed && !p.longSent && TOUCH_LONG_MS <= at - p.since) {
+            p.longSent = true;
+            emit(pad, TOUCH_LONG);
+        }
+    }
+
+    public:
+    cTouchInput() : pTable(nullptr), pads(0), dropped(0) { memset(aPad, 0, sizeof(aPad)); }
+
+    void begin(sTouchSensor *pT) {
+        pTable = pT;
+        for (pads = 0; pads < TOUCH_PADS && 0 <= pTable[pads].pin; pads++) {
+#if ESP32_S3
+            touchAttachInterruptArg(pTable[pads].pin, onTouch, (void *) (intptr_t) pads, pTable[pads].threshold);
+#endif
+        }
+    }
+
+    // interrupt context
+    void edge(int pad, bool touched) {
+        sEdge e = { (uint8_t) pad, touched, (uint32_t) millis() };
+        edges.push(e); // full: the level of the next edge still wins
+    }
+
+    void poll(unsigned long now) {
+        sEdge e;
+        while (edges.pop(e)) {
+            settle(e.pad, e.ms);
+            aPad[e.pad].level = e.touched;
+            aPad[e.pad].since = e.ms;
+        }
+        for (int pad = 0; pad < pads; pad++) {
+            settle(pad, now);
+        }
+    }
+
+    bool getEvent(sTouchEvent &ev) { return events.pop(ev); }
+};
+
+extern cTouchInput touchInput;
+
+#if ESP32_S3
+void IRAM_ATTR
+cTouchInput::onTouch(void *pArg)
+{
+    int pad = (int) (intptr_t) pArg;
+    touchInput.edge(pad, touchInterruptGetLastStatus(touchInput.pTable[pad].pin));
+}
+#endif
+
+class cTouchMenu {
+    const sMenueInfo *pTable;
+    int cur;        // entry in the table, -1: closed
+    bool editing;
+    bool longSeen;  // TOUCH1 held long, its release does not select
+    char aText[16];
+
+    static bool isTop(int id) { return (id & 0x0fff) == 0; }
+    static bool sameLevel(int a, int b) { return isTop(a) ? isTop(b) : !isTop(b) && (a & 0xf000) == (b & 0xf000); }
+
+    // next (dir 1) or previous (dir -1) entry of the same level, wraps around
+    int step(int idx, int dir) const {
+        int cnt = 0;
+        while (pTable[cnt].id) {
+            cnt++;
+        }
+        for (int off = 1; off < cnt; off++) {
+            int next = (idx + dir * off + cnt * off) % cnt;
+            if (sameLevel(pTable[idx].id, pTable[next].id)) {
+                return next;
+            }
+        }
+        return idx;
+    }
+
+    int find(int id) const {
+        for (int idx = 0; pTable[idx].id; idx++) {
+            if (pTable[idx].id == id) {
+                return idx;
+            }
+        }
+        return -1;
+    }
+
+    void change(int dir) {
+        switch (pTable[cur].id) {
+        case MENU_GAIN:
+            pipeParams.set("gain", pipeParams.get("gain") + dir); // out of range: unchanged
+            break;
+        case MENU_MODE:
+            pipeMode = pipeMode == PIPE_MODE_RUN ? PIPE_MODE_STOP : PIPE_MODE_RUN;
+            break;
+        }
+    }
+
+    void select() {
+        int id = pTable[cur].id;
+        if (id == MENU_GAIN || id == MENU_MODE) {
+            editing = !editing;
+        } else if (isTop(id) && pTable[cur + 1].id && !isTop(pTable[cur + 1].id)) {
+            cur++; // first entry below
+        } else {
+            cur = -1; // Main, Exit
+        }
+    }
+
+    void show() {
+        const char *pTitle = aDevName; // set by setup()
+        if (0 <= cur) {
+            int id = pTable[cur].id;
+            const char *pOpen = editing ? "<" : "";
+            const char *pClose = editing ? ">" : "";
+            if (id == MENU_GAIN) {
+                snprintf(aText, sizeof(aText), "Gain: %s%d%s", pOpen, (int) pipeParams.get("gain"), pClose);
+            } else if (id == MENU_MODE) {
+                snprintf(aText, sizeof(aText), "Mode: %s%s%s", pOpen, pipeMode == PIPE_MODE_RUN ? "run" : "stop", pClose);
+            } else {
+                snprintf(aText, sizeof(aText), "%s%s", pTable[cur].pName,
+                         pTable[cur + 1].id && isTop(id) && !isTop(pTable[cur + 1].id) ? " ..." : "");
+            }
+            pTitle = aText;
+        }
+        dispDirty.setText(pCurDispItems->pDevTitle, pTitle);
+    }
+
+    public:
+    cTouchMenu(const sMenueInfo *pT) : pTable(pT), cur(-1), editing(false), longSeen(false) { aText[0] = 0; }
+
+    bool isOpen() const { return 0 <= cur; }
+
+    void poll(cTouchInput &input, unsigned long now) {
+        sTouchEvent ev;
+        bool changed = false;
+        bool wasOpen = isOpen();
+
+        input.poll(now);
+        while (input.getEvent(ev)) {
+            // TOUCH1 selects on a short release, TOUCH0/2 act on the press
+            bool select1 = ev.pad == 1 && ev.type == TOUCH_RELEASE && !longSeen;
+            if (ev.pad == 1) {
+                longSeen = ev.type == TOUCH_LONG || (longSeen && ev.type != TOUCH_PRESS);
+            }
+            if (ev.pad == 1 ? ev.type == TOUCH_PRESS || (ev.type == TOUCH_RELEASE && !select1)
+                            : ev.type != TOUCH_PRESS) {
+                continue;
+            }
+            changed = true;
+            if (cur < 0) {
+                cur = ev.type == TOUCH_LONG ? find(MENU_MAIN) : -1;
+            } else if (ev.type == TOUCH_LONG) {
+                // up one level, closed from the top level
+                if (editing) {
+                    editing = false;
+                } else {
+                    cur = isTop(pTable[cur].id) ? -1 : find(pTable[cur].id & 0xf000);
+                }
+            } else if (ev.pad == 1) {
+                select();
+            } else if (editing) {
+                change(ev.pad == 0 ? -1 : 1);
+            } else {
+                cur = step(cur, ev.pad == 0 ? -1 : 1);
+            }
+        }
+        if (changed && (wasOpen || isOpen()) && pCurDispItems) {
+            show();
+        }
+    }
+};
+
+extern cTouchMenu touchMenu;
+
+#endif // TOUCH_H
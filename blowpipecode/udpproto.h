@@ -0,0 +1,225 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Blow -> Pipe UDP wire format
+ * v1: 4 nibble tagged 16 bit words (VAL_TIME, VAL_MVOLT, VAL_MBAR, VAL_TEMP)
+ * v2: batch of timestamped samples, the first word is tagged VAL_V2 so both
+ *     formats can be told apart by the top nibble of the first word
+ *   word 0:  VAL_V2 | flags | sample count
+ *   word 1:  datagram sequence number
+ *   u32:     sender micros() of the first sample
+ *   i32:     pressure of the first sample in Pa
+ *   [status: u16 battery mV, i16 temperature 0.1 C]   if V2_STATUS is set
+ *   [u16 new round trip time in 16 us units]          if V2_RTT is set, once per measurement
+ *   [i32 pipe - blow clock offset at the first sample in us,
+ *    u16 uncertainty of the offset in us]              if V2_CLOCK is set
+ *   count x (u16 us since the previous sample, i16 Pa relative to the first sample)
+ * echo: Pipe -> Blow answer to every accepted v2 datagram
+ *   word 0:  VAL_ECHO
+ *   word 1:  sequence number of the echoed datagram
+ *   u32:     sender micros() of its first sample, copied unchanged
+ *   u32:     pipe micros() when the datagram was read
+ *   u32:     pipe micros() when the echo was sent
+ * udpEncodeV2(pBuf, pkt): build a datagram, returns the length
+ * udpDecodeV2(pBuf, len, pkt): parse a datagram, false if it is not a valid v2 one
+ * udpEncodeEcho(pBuf, echo)/udpDecodeEcho(pBuf, len, echo): same for the echo
+ * Only depends on stdint.h/string.h so it can be compiled into the host simulation.
+ */
+#ifndef UDPPROTO_H
+#define UDPPROTO_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define UDP_PORT 1805
+
+#define VAL_TIME  0x4000
+#define VAL_MVOLT 0x5000
+#define VAL_MBAR  0x6000
+#define VAL_TEMP  0x7000
+#define VAL_V2    0x8000
+#define VAL_ECHO  0x9000
+
+#define V2_STATUS      0x0100
+#define V2_RTT         0x0200
+#define V2_CLOCK       0x0400
+#define V2_COUNT_MASK  0x00ff
+#define V2_MAX_SAMPLES 16
+#define V2_HEAD_SIZE   12
+#define V2_STATUS_SIZE 4
+#define V2_RTT_SIZE    2
+#define V2_RTT_SHIFT   4 // 16 us units, up to about 1 s
+#define V2_CLOCK_SIZE  6
+#define V2_SAMPLE_SIZE 4
+#define V2_MAX_SIZE    (V2_HEAD_SIZE + V2_STATUS_SIZE + V2_RTT_SIZE + V2_CLOCK_SIZE + V2_MAX_SAMPLES * V2_SAMPLE_SIZE)
+#define ECHO_SIZE      16
+
+struct sUDPSample {
+    uint32_t time; // sender micros()
+    int32_t pa;    // absolute pressure in Pa
+};
+
+struct sUDPPacket {
+    uint16_t seq;
+    uint8_t count;
+    bool hasStatus;
+    bool hasRtt;
+    bool hasClock;
+    uint16_t mvolt;
+    int16_t temp;
+    uint32_t rtt;  // us
+    int32_t offset;    // us, pipe time = sample time + offset
+    uint16_t clockErr; // us
+    sUDPSample aSample[V2_MAX_SAMPLES];
+};
+
+struct sUDPEcho {
+    uint16_t seq;
+    uint32_t time;
+    uint32_t rxTime; // pipe clock
+    uint32_t txTime;
+};
+
+// true if the sample can still be added to the packet
+inline bool
+udpFitsV2(const sUDPPacket &pkt, const sUDPSample &sample)
+{
+    if (pkt.count == 0) {
+        return true;
+    }
+    if (V2_MAX_SAMPLES <= pkt.count) {
+        return false;
+    }
+    int32_t dPa = sample.pa - pkt.aSample[0].pa;
+    uint32_t dt = sample.time - pkt.aSample[pkt.count - 1].time;
+    return dt <= 0xffff && -32768 <= dPa && dPa <= 32767;
+}
+
+inline int
+udpEncodeV2(uint8_t *pBuf, const sUDPPacket &pkt)
+{
+    uint16_t tag = VAL_V2 | (pkt.hasStatus ? V2_STATUS : 0) | (pkt.hasRtt ? V2_RTT : 0) |
+                   (pkt.hasClock ? V2_CLOCK : 0) | (pkt.count & V2_COUNT_MASK);
+    uint32_t time = pkt.count ? pkt.aSample[0].time : 0;
+    int32_t base = pkt.count ? pkt.aSample[0].pa : 0;
+    uint8_t *pPtr = pBuf;
+
+    memcpy(pPtr, &tag, 2);      pPtr += 2;
+    memcpy(pPtr, &pkt.seq, 2);  pPtr += 2;
+    memcpy(pPtr, &time, 4);     pPtr += 4;
+    memcpy(pPtr, &base, 4);     pPtr += 4;
+    if (pkt.hasStatus) {
+        memcpy(pPtr, &pkt.mvolt, 2); pPtr += 2;
+        memcpy(pPtr, &pkt.temp, 2);  pPtr += 2;
+    }
+    if (pkt.hasRtt) {
+        uint32_t rtt = pkt.rtt >> V2_RTT_SHIFT;
+        uint16_t val = rtt < 0xffff ? rtt : 0xffff;
+        memcpy(pPtr, &val, 2); pPtr += 2;
+    }
+    if (pkt.hasClock) {
+        memcpy(pPtr, &pkt.offset, 4);   pPtr += 4;
+        memcpy(pPtr, &pkt.clockErr, 2); pPtr += 2;
+    }
+    for (int idx = 0; idx < pkt.count; idx++) {
+        uint16_t dt = idx ? pkt.aSample[idx].time - pkt.aSample[idx - 1].time : 0;
+        int16_t dPa = pkt.aSample[idx].pa - base;
+        memcpy(pPtr, &dt, 2);  pPtr += 2;
+        memcpy(pPtr, &dPa, 2); pPtr += 2;
+    }
+    return pPtr - pBuf;
+}
+
+inline bool
+udpDecodeV2(const uint8_t *pBuf, int len, sUDPPacket &pkt)
+{
+    uint16_t tag;
+    uint32_t time;
+    int32_t base;
+    const uint8_t *pPtr = pBuf;
+
+    if (len < V2_HEAD_SIZE) {
+        return false;
+    }
+    memcpy(&tag, pPtr, 2);
+    if ((tag & 0xf000) != VAL_V2) {
+        return false;
+    }
+    pkt.count = tag & V2_COUNT_MASK;
+    pkt.hasStatus = (tag & V2_STATUS) != 0;
+    pkt.hasRtt = (tag & V2_RTT) != 0;
+    pkt.hasClock = (tag & V2_CLOCK) != 0;
+    if (V2_MAX_SAMPLES < pkt.count ||
+        len < V2_HEAD_SIZE + (pkt.hasStatus ? V2_STATUS_SIZE : 0) + (pkt.hasRtt ? V2_RTT_SIZE : 0) +
+              (pkt.hasClock ? V2_CLOCK_SIZE : 0) + pkt.count * V2_SAMPLE_SIZE) {
+        return false;
+    }
+    pPtr += 2;
+    memcpy(&pkt.seq, pPtr, 2); pPtr += 2;
+    memcpy(&time, pPtr, 4);    pPtr += 4;
+    memcpy(&base, pPtr, 4);    pPtr += 4;
+    if (pkt.hasStatus) {
+        memcpy(&pkt.mvolt, pPtr, 2); pPtr += 2;
+        memcpy(&pkt.temp, pPtr, 2);  pPtr += 2;
+    }
+    pkt.rtt = 0;
+    if (pkt.hasRtt) {
+        uint16_t val;
+        memcpy(&val, pPtr, 2); pPtr += 2;
+        pkt.rtt = (uint32_t) val << V2_RTT_SHIFT;
+    }
+    pkt.offset = 0;
+    pkt.clockErr = 0;
+    if (pkt.hasClock) {
+        memcpy(&pkt.offset, pPtr, 4);   pPtr += 4;
+        memcpy(&pkt.clockErr, pPtr, 2); pPtr += 2;
+    }
+    for (int idx = 0; idx < pkt.count; idx++) {
+        uint16_t dt;
+        int16_t dPa;
+        memcpy(&dt, pPtr, 2);  pPtr += 2;
+        memcpy(&dPa, pPtr, 2); pPtr += 2;
+        time += dt;
+        pkt.aSample[idx].time = time;
+        pkt.aSample[idx].pa = base + dPa;
+    }
+    return true;
+}
+
+inline int
+udpEncodeEcho(uint8_t *pBuf, const sUDPEcho &echo)
+{
+    uint16_t tag = VAL_ECHO;
+
+    memcpy(pBuf, &tag, 2);
+    memcpy(pBuf + 2, &echo.seq, 2);
+    memcpy(pBuf + 4, &echo.time, 4);
+    memcpy(pBuf + 8, &echo.rxTime, 4);
+    memcpy(pBuf + 12, &echo.txTime, 4);
+    return ECHO_SIZE;
+}
+
+inline bool
+udpDecodeEcho(const uint8_t *pBuf, int len, sUDPEcho &echo)
+{
+    uint16_t tag;
+
+    if (len < ECHO_SIZE) {
+        return false;
+    }
+    memcpy(&tag, pBuf, 2);
+    if ((tag & 0xf000) != VAL_ECHO) {
+        return false;
+    }
+    memcpy(&echo.seq, pBuf + 2, 2);
+    memcpy(&echo.time, pBuf + 4, 4);
+    memcpy(&echo.rxTime, pBuf + 8, 4);
+    memcpy(&echo.txTime, pBuf + 12, 4);
+    return true;
+}
+
+#endif // UDPPROTO_H
@@ -0,0 +1,168 @@
+/*
+ * Licensed under Apache 2.0
+ * Text version: https://www.apache.org/licenses/LICENSE-2.0.txt
+ * SPDX short identifier: Apache-2.0
+ * OSI Approved License: https://opensource.org/licenses/Apache-2.0
+ * Author: Robert Wiesner
+ *
+ * Station link of the blow to the pipe AP
+ * The channel and BSSID of the last connect are kept in the cfg record
+ * REC_WIFI_AP, the next connect goes directly to that AP without a scan.
+ * cWifiLink:
+ *   begin(pSSID, pPassword): read the cached AP, the strings must stay valid
+ *   connectFast(): setup(), directed connect to the cached AP for at most
+ *     WIFI_FAST_MS, WL_NO_SSID_AVAIL without a cache or on a failure
+ *   connectScan(): setup(), full connect with a scan, waits up to 15 s
+ *   poll(now): display core, notices a lost link and reconnects in the
+ *     background, directed first, after WIFI_FAST_MS with a scan, a scan
+ *     that did not connect in WIFI_SCAN_MS starts over
+ *   isUp()/getStatus(pBuffer): boot to connect, reconnect count and times
+ * RP2040W: the CYW43 driver takes no channel/BSSID, a fast connect is a
+ *   normal one with the short timeout, the cache is not written.
+ */
+#ifndef WIFILINK_H
+#define WIFILINK_H
+
+#define WIFI_FAST_MS  3000  // directed connect
+#define WIFI_SCAN_MS  15000 // connect with a scan
+
+struct sWifiAp {
+    uint8_t channel;
+    uint8_t aBssid[6];
+};
+
+class cWifiLink {
+    enum { LINK_UP, LINK_FAST, LINK_SCAN };
+    const char *pSSID;
+    const char *pPassword;
+    sWifiAp ap;
+    bool haveAp;
+    int state;
+    unsigned long lostAt;   // ms
+    unsigned long tryAt;    // ms, start of the current attempt
+    unsigned long bootMs;   // boot to the first connect
+    unsigned long lastMs;   // last reconnect
+    unsigned long maxMs;
+    uint32_t reconnects;
+    bool fast;              // last connect without a scan
+
+    void startFast() {
+        WiFi.disconnect();
+#if ESP32_S3
+        if (haveAp) {
+            WiFi.begin(pSSID, pPassword, ap.channel, ap.aBssid);
+            return;
+        }
+#endif
+        WiFi.begin(pSSID, pPassword);
+    }
+
+    void onConnected(bool directed) {
+        fast = directed;
+        state = LINK_UP;
+#if ESP32_S3
+        sWifiAp cur;
+        cur.channel = WiFi.channel();
+        memcpy(cur.aBssid, WiFi.BSSID(), sizeof(cur.aBssid));
+        if (!haveAp || memcmp(&cur, &ap, sizeof(ap)) != 0) {
+            ap = cur;
+            haveAp = true;
+            cfg.set(REC_WIFI_AP, &ap, sizeof(ap));
+        }
+#endif
+    }
+
+    public:
+    cWifiLink() : pSSID(""), pPassword(""), haveAp(false), state(LINK_SCAN), lostAt(0), tryAt(0),
+                  bootMs(0), lastMs(0), maxMs(0), reconnects(0), fast(false) {}
+
+    void begin(const char *pS, const char *pP) {
+        pSSID = pS;
+        pPassword = pP;
+        haveAp = cfg.get(REC_WIFI_AP, &ap, sizeof(ap)) == sizeof(ap) && ap.channel;
+    }
+
+    int connectFast() {
+        unsigned long start = millis();
+#if ESP32_S3
+        if (!haveAp) {
+            return WL_NO_SSID_AVAIL;
+        }
+#endif
+        startFast();
+        while (WiFi.status() != WL_CONNECTED && millis() - start < WIFI_FAST_MS) {
+            delay(10);
+        }
+        if (WiFi.status() != WL_CONNECTED) {
+            WiFi.disconnect();
+            return WL_NO_SSID_AVAIL; // stale cache, scan
+        }
+        bootMs = millis();
+        onConnected(true);
+        return WL_CONNECTED;
+    }
+
+    int connectScan() {
+        WiFi.disconnect();
+        WiFi.begin(pSSID, pPassword);
+        int status = WiFi.waitForConnectResult(); // timeout 15 sec
+        if (status == WL_CONNECTED) {
+            bootMs = millis();
+            onConnected(false);
+        }
+        return status;
+    }
+
+    void poll(unsigned long now) {
+        bool connected = WiFi.status() == WL_CONNECTED;
+
+        switch (state) {
+        case LINK_UP:
+            if (!connected) {
+                lostAt = tryAt = now;
+                state = LINK_FAST;
+                startFast();
+            }
+            break;
+        case LINK_FAST:
+        case LINK_SCAN:
+            if (connected && !bootMs) {
+                bootMs = now; // setup() gave up, connected in the background
+                onConnected(false);
+            } else if (connected) {
+                lastMs = now - lostAt;
+                maxMs = lastMs < maxMs ? maxMs : lastMs;
+                reconnects++;
+                onConnected(state == LINK_FAST);
+            } else if (state == LINK_FAST && WIFI_FAST_MS < now - tryAt) {
+                tryAt = now;
+                state = LINK_SCAN;
+                WiFi.disconnect();
+                WiFi.begin(pSSID, pPassword);
+            } else if (state == LINK_SCAN && WIFI_SCAN_MS < now - tryAt) {
+                tryAt = now;
+                state = LINK_FAST;
+                startFast();
+            }
+            break;
+        }
+    }
+
+    bool isUp() const { return state == LINK_UP; }
+
+    void getStatus(char *pBuffer) {
+        if (state == LINK_UP) {
+            sprintf(pBuffer, "Wi-Fi: up, channel %d%s, connect %lu ms after boot, %lu reconnects, last %lu ms, max %lu ms",
+                    haveAp ? ap.channel : 0, fast ? " (cached)" : "", bootMs,
+                    (unsigned long) reconnects, lastMs, maxMs);
+        } else {
+            sprintf(pBuffer, "Wi-Fi: %s for %lu ms, %lu reconnects, last %lu ms, max %lu ms",
+                    state == LINK_FAST ? "reconnecting" : "scanning", millis() - lostAt,
+                    (unsigned long) reconnects, lastMs, maxMs);
+        }
+    }
+};
+
+extern cWifiLink wifiLink;
+
+#endif // WIFILINK_H